@@ -5,14 +5,701 @@
 #include <chrono>
 #include <random>
 #include <functional>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+#include <new>
+#include <unistd.h>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <pthread.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <cmath>
+#include <ctime>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+
+
+// Alignment (in bytes) of every matrix buffer and row; one cache line / one zmm register
+constexpr int MATRIX_ALIGNMENT = 64;
+constexpr int MATRIX_ALIGN_FLOATS = MATRIX_ALIGNMENT / sizeof(float);
+
+// Non-owning view of a row-major block of elements with a leading-dimension stride.
+// T is the element type for a mutable view and its const version for a read-only one.
+template <typename T>
+struct BasicMatrixView {
+    T* data = nullptr;
+    int rows = 0;
+    int cols = 0;
+    int ld = 0;   // Distance in elements between the starts of two consecutive rows
+
+    BasicMatrixView() = default;
+    BasicMatrixView(T* data, int rows, int cols, int ld) : data(data), rows(rows), cols(cols), ld(ld) {}
+
+    // Allow a mutable view to be passed where a read-only view is expected
+    template <typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+    BasicMatrixView(const BasicMatrixView<U>& other) : data(other.data), rows(other.rows), cols(other.cols), ld(other.ld) {}
+
+    T* row(int i) const { return data + static_cast<size_t>(i) * ld; }
+    T& operator()(int i, int j) const { return data[static_cast<size_t>(i) * ld + j]; }
+
+    // Sub-block starting at (i, j) with the given extent, sharing the same storage
+    BasicMatrixView block(int i, int j, int block_rows, int block_cols) const {
+        return BasicMatrixView(row(i) + j, block_rows, block_cols, ld);
+    }
+};
+
+typedef BasicMatrixView<float> MatrixView;
+typedef BasicMatrixView<const float> ConstMatrixView;
+
+// Dense row-major matrix stored in a single 64-byte aligned buffer.
+// Every row is padded to a multiple of 64 bytes (16 floats) so that each row starts on a cache line;
+// the padding is zero-filled and never read back as part of the logical matrix.
+// T is float for the fp32 kernels and a 16- or 8-bit storage type for the reduced-precision ones.
+template <typename T>
+class BasicMatrix {
+    struct AlignedDeleter {
+        void operator()(T* p) const { std::free(p); }
+    };
+
+    std::unique_ptr<T[], AlignedDeleter> buffer;
+    int num_rows = 0;
+    int num_cols = 0;
+    int stride = 0;
+
+    static int padded_stride(int cols) {
+        constexpr int per_line = MATRIX_ALIGNMENT / sizeof(T);
+        return (cols + per_line - 1) / per_line * per_line;
+    }
+
+    void allocate(int rows, int cols) {
+        num_rows = rows;
+        num_cols = cols;
+        stride = padded_stride(cols);
+        size_t bytes = static_cast<size_t>(rows) * stride * sizeof(T);
+        if (bytes == 0) {
+            buffer.reset();
+            return;
+        }
+        T* p = static_cast<T*>(std::aligned_alloc(MATRIX_ALIGNMENT, bytes));
+        if (p == nullptr) {
+            throw std::bad_alloc();
+        }
+        buffer.reset(p);
+    }
+
+public:
+    BasicMatrix() = default;
+
+    // Allocate a rows x cols matrix initialized with zeros
+    BasicMatrix(int rows, int cols) {
+        allocate(rows, cols);
+        if (buffer) {
+            std::memset(buffer.get(), 0, static_cast<size_t>(num_rows) * stride * sizeof(T));
+        }
+    }
+
+    BasicMatrix(const BasicMatrix& other) {
+        allocate(other.num_rows, other.num_cols);
+        if (buffer) {
+            std::memcpy(buffer.get(), other.buffer.get(), static_cast<size_t>(num_rows) * stride * sizeof(T));
+        }
+    }
+
+    BasicMatrix& operator=(const BasicMatrix& other) {
+        if (this != &other) {
+            BasicMatrix copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    BasicMatrix(BasicMatrix&& other) noexcept
+        : buffer(std::move(other.buffer)), num_rows(other.num_rows), num_cols(other.num_cols), stride(other.stride) {
+        other.num_rows = other.num_cols = other.stride = 0;
+    }
+
+    BasicMatrix& operator=(BasicMatrix&& other) noexcept {
+        buffer = std::move(other.buffer);
+        num_rows = other.num_rows;
+        num_cols = other.num_cols;
+        stride = other.stride;
+        other.num_rows = other.num_cols = other.stride = 0;
+        return *this;
+    }
+
+    int rows() const { return num_rows; }
+    int cols() const { return num_cols; }
+    int ld() const { return stride; }
+
+    T* data() { return buffer.get(); }
+    const T* data() const { return buffer.get(); }
+
+    T* row(int i) { return buffer.get() + static_cast<size_t>(i) * stride; }
+    const T* row(int i) const { return buffer.get() + static_cast<size_t>(i) * stride; }
+
+    T& operator()(int i, int j) { return buffer[static_cast<size_t>(i) * stride + j]; }
+    const T& operator()(int i, int j) const { return buffer[static_cast<size_t>(i) * stride + j]; }
+
+    BasicMatrixView<T> view() { return BasicMatrixView<T>(buffer.get(), num_rows, num_cols, stride); }
+    BasicMatrixView<const T> view() const { return BasicMatrixView<const T>(buffer.get(), num_rows, num_cols, stride); }
+
+    BasicMatrixView<T> block(int i, int j, int block_rows, int block_cols) { return view().block(i, j, block_rows, block_cols); }
+    BasicMatrixView<const T> block(int i, int j, int block_rows, int block_cols) const { return view().block(i, j, block_rows, block_cols); }
+};
+
+typedef BasicMatrix<float> Matrix;
+
+// Microkernel signature: C[0:mr, 0:nr] += packed A micro-panel (kc x mr) * packed B micro-panel (kc x nr)
+typedef void (*GemmMicroKernel)(int kc, const float* a_pack, const float* b_pack, float* c, int ldc);
+
+// Register tile (mr x nr) and cache blocking (mc/kc/nc) of the packed GEMM engine.
+// kc x nr of B stays in L1, mc x kc of A stays in L2 and kc x nc of B stays in L3.
+struct GemmKernel {
+    const char* name;
+    int mr;
+    int nr;
+    int mc;
+    int kc;
+    int nc;
+    GemmMicroKernel micro;
+};
+
+// Order of the block loops in the cache-blocked (non-packed) kernels
+enum class BlockLoopOrder {
+    IJK,   // i blocks, then j blocks, then k blocks: each result block is finished before moving on
+    IKJ    // i blocks, then k blocks, then j blocks: each A block is reused across a whole row of B blocks
+};
+
+// Parameters chosen by the autotuner for one CPU model and shape class.
+// mc/kc/nc of 0 mean "derive from the cache sizes", threads of 0 means "use the caller's thread count".
+struct TuningParams {
+    std::string kernel;
+    int mc = 0;
+    int kc = 0;
+    int nc = 0;
+    int block_size = 64;
+    BlockLoopOrder loop_order = BlockLoopOrder::IJK;
+    int threads = 0;
+    int strassen_cutoff = 512;   // Strassen-Winograd recursion stops once any dimension is at or below this
+};
+
+// Tuned parameters keyed by "<cpu model>\t<shape class>", stored as one text line per entry
+class TuningProfile {
+    std::map<std::string, TuningParams> entries;
+
+public:
+    bool load(const std::string& filename);
+    bool save(const std::string& filename) const;
+
+    const TuningParams* find(const std::string& cpu, const std::string& shape) const {
+        auto it = entries.find(cpu + "\t" + shape);
+        return it == entries.end() ? nullptr : &it->second;
+    }
+
+    void set(const std::string& cpu, const std::string& shape, const TuningParams& params) {
+        entries[cpu + "\t" + shape] = params;
+    }
+};
+
+// Bump allocator for Strassen-Winograd temporaries: one aligned buffer sized before the recursion starts,
+// handed out as row-padded views and released in stack order
+class ScratchArena {
+    std::unique_ptr<float[], void (*)(float*)> buffer{nullptr, [](float* p) { std::free(p); }};
+    size_t capacity = 0;
+    size_t used = 0;
+
+public:
+    static int padded_ld(int cols) {
+        return (cols + MATRIX_ALIGN_FLOATS - 1) / MATRIX_ALIGN_FLOATS * MATRIX_ALIGN_FLOATS;
+    }
+
+    explicit ScratchArena(size_t floats) : capacity(floats) {
+        if (floats > 0) {
+            float* p = static_cast<float*>(std::aligned_alloc(MATRIX_ALIGNMENT, floats * sizeof(float)));
+            if (p == nullptr) {
+                throw std::bad_alloc();
+            }
+            buffer.reset(p);
+        }
+    }
+
+    MatrixView take(int rows, int cols) {
+        int ld = padded_ld(cols);
+        size_t floats = static_cast<size_t>(rows) * ld;
+        if (used + floats > capacity) {
+            throw std::logic_error("ScratchArena: scratch size was underestimated");
+        }
+        MatrixView view(buffer.get() + used, rows, cols, ld);
+        used += floats;
+        return view;
+    }
+
+    size_t mark() const { return used; }
+    void release(size_t mark) { used = mark; }
+};
+
+// Measured and theoretical errors of a Strassen-Winograd product, in units of max|A| * max|B|
+struct StrassenErrorReport {
+    int depth;                 // Recursion levels above the classical base case
+    double strassen_error;     // max |C_strassen - C_exact|
+    double classical_error;    // max |C_classical - C_exact|
+    double strassen_bound;     // Higham's bound for Winograd's variant
+    double classical_bound;    // Higham's bound for the classical product
+};
+
+// Compressed sparse row storage: the nonzeros of row i are values[row_ptr[i] .. row_ptr[i + 1])
+struct CSRMatrix {
+    int rows = 0;
+    int cols = 0;
+    std::vector<int> row_ptr;
+    std::vector<int> col_idx;
+    std::vector<float> values;
+
+    size_t nnz() const { return values.size(); }
+};
+
+// Compressed sparse column storage: the nonzeros of column j are values[col_ptr[j] .. col_ptr[j + 1])
+struct CSCMatrix {
+    int rows = 0;
+    int cols = 0;
+    std::vector<int> col_ptr;
+    std::vector<int> row_idx;
+    std::vector<float> values;
+
+    size_t nnz() const { return values.size(); }
+};
+
+// Blocked CSR: CSR over dense block_rows x block_cols tiles, each stored row-major in `blocks`.
+// Only tiles with at least one nonzero are kept; padding inside a kept tile is stored as zeros.
+struct BCSRMatrix {
+    int rows = 0;
+    int cols = 0;
+    int block_rows = 0;
+    int block_cols = 0;
+    std::vector<int> block_row_ptr;
+    std::vector<int> block_col_idx;
+    std::vector<float> blocks;
+
+    size_t num_blocks() const { return block_col_idx.size(); }
+};
+
+// Sparse kernel picked by multiply_sparse_auto
+enum class SparseKernel {
+    Dense,        // Both operands dense enough for the packed GEMM engine
+    CSRxDense,    // Sparse A, dense B
+    BCSRxDense,   // Sparse A whose nonzeros cluster into dense tiles
+    DensexCSC,    // Dense A, sparse B
+    CSRxCSR       // Both sparse (Gustavson)
+};
+
+// 16-bit floating-point storage formats. Both hold raw bit patterns; all arithmetic is done in fp32.
+struct bfloat16 {
+    uint16_t bits;   // Upper half of an fp32: 8-bit exponent, 7-bit mantissa
+};
+
+struct float16 {
+    uint16_t bits;   // IEEE binary16: 5-bit exponent, 10-bit mantissa
+};
+
+// Symmetric int8 quantization: M(i, j) ~= values(i, j) * scale, with one scale per row (the left operand
+// of a product) or per column (the right operand) so that every output entry needs a single rescale
+struct QuantizedMatrix {
+    BasicMatrix<int8_t> values;
+    std::vector<float> scales;
+    bool per_column = false;
+};
+
+// Error of one reduced-precision product against the fp32 multiply_native result
+struct PrecisionError {
+    std::string name;
+    double convert_s;              // Converting / quantizing both operands
+    double multiply_s;             // The reduced-precision product itself
+    double max_abs_error;
+    double max_rel_error;          // max_abs_error / max |reference|
+    double rel_frobenius_error;    // ||C - reference||_F / ||reference||_F
+};
+
+// Hardware events collected by the optional perf_event_open instrumentation
+enum PerfEventId {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_FP_OPS,       // Single-precision FLOPs, weighted by vector width (Intel FP_ARITH_INST_RETIRED only)
+    PERF_EVENT_COUNT
+};
+
+static const char* const PERF_EVENT_NAMES[PERF_EVENT_COUNT] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses", "fp_ops"
+};
+
+// Counter values for one thread; events that could not be opened stay at zero
+struct PerfSample {
+    double values[PERF_EVENT_COUNT] = {};
+
+    PerfSample& operator+=(const PerfSample& other) {
+        for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+            values[e] += other.values[e];
+        }
+        return *this;
+    }
+
+    PerfSample operator-(const PerfSample& other) const {
+        PerfSample diff;
+        for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+            diff.values[e] = values[e] - other.values[e];
+        }
+        return diff;
+    }
+};
+
+// Counters of the calling thread, opened once per thread on first use.
+// Each event is opened on its own so that a missing event (no PMU in a VM, perf_event_paranoid,
+// non-Intel FP events) only disables that column instead of the whole instrumentation.
+class ThreadPerfCounters {
+    struct Counter {
+        int fd;
+        PerfEventId event;
+        double weight;
+    };
+
+    std::vector<Counter> counters;
+    bool opened[PERF_EVENT_COUNT] = {};
+
+    void open_event(PerfEventId event, uint32_t type, uint64_t config, double weight = 1.0) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+        if (fd >= 0) {
+            counters.push_back(Counter{fd, event, weight});
+            opened[event] = true;
+        }
+    }
+
+    static uint64_t cache_event(uint64_t cache, uint64_t op, uint64_t result) {
+        return cache | (op << 8) | (result << 16);
+    }
+
+public:
+    ThreadPerfCounters() {
+        open_event(PERF_CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        open_event(PERF_INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        open_event(PERF_L1D_MISSES, PERF_TYPE_HW_CACHE,
+                   cache_event(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+        open_event(PERF_LLC_MISSES, PERF_TYPE_HW_CACHE,
+                   cache_event(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+        open_event(PERF_DTLB_MISSES, PERF_TYPE_HW_CACHE,
+                   cache_event(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+
+        // FP_ARITH_INST_RETIRED (event 0xC7): scalar, 128-, 256- and 512-bit packed single precision.
+        // An FMA retires as two operations, so weighting by lane count gives FLOPs.
+        __builtin_cpu_init();
+        if (__builtin_cpu_is("intel")) {
+            const uint64_t umasks[] = {0x02, 0x08, 0x20, 0x80};
+            const double lanes[] = {1.0, 4.0, 8.0, 16.0};
+            for (int w = 0; w < 4; ++w) {
+                open_event(PERF_FP_OPS, PERF_TYPE_RAW, 0xC7 | (umasks[w] << 8), lanes[w]);
+            }
+        }
+    }
+
+    ~ThreadPerfCounters() {
+        for (const auto& counter : counters) {
+            close(counter.fd);
+        }
+    }
+
+    ThreadPerfCounters(const ThreadPerfCounters&) = delete;
+    ThreadPerfCounters& operator=(const ThreadPerfCounters&) = delete;
+
+    bool available(PerfEventId event) const { return opened[event]; }
+    bool any_available() const { return !counters.empty(); }
+
+    // Current counts, scaled up when the kernel had to multiplex more events than there are counters
+    PerfSample read() const {
+        PerfSample sample;
+        for (const auto& counter : counters) {
+            uint64_t data[3] = {0, 0, 0};   // value, time enabled, time running
+            if (::read(counter.fd, data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))) {
+                continue;
+            }
+            double value = static_cast<double>(data[0]);
+            if (data[2] > 0 && data[2] < data[1]) {
+                value *= static_cast<double>(data[1]) / data[2];
+            }
+            sample.values[counter.event] += value * counter.weight;
+        }
+        return sample;
+    }
+
+    static ThreadPerfCounters& current() {
+        thread_local ThreadPerfCounters counters;
+        return counters;
+    }
+};
+
+// Counter totals of one kernel, kept per pool worker (slot 0 is the calling thread)
+struct PerfKernelStats {
+    std::string kernel;
+    int invocations = 0;
+    std::vector<PerfSample> per_thread;
+    std::mutex mutex;
+
+    void add(int thread, const PerfSample& delta) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (static_cast<int>(per_thread.size()) <= thread) {
+            per_thread.resize(thread + 1);
+        }
+        per_thread[thread] += delta;
+    }
+
+    PerfSample total() const {
+        PerfSample sum;
+        for (const auto& sample : per_thread) {
+            sum += sample;
+        }
+        return sum;
+    }
+};
+
+// Kernel currently being measured; null when instrumentation is off
+inline std::atomic<PerfKernelStats*>& active_perf_stats() {
+    static std::atomic<PerfKernelStats*> stats{nullptr};
+    return stats;
+}
+
+// Measures one kernel invocation: the calling thread across the whole scope, pool workers per task.
+// Does nothing when `stats` is null, so call sites can wrap kernels unconditionally.
+class PerfScope {
+    PerfKernelStats* stats;
+    PerfSample start;
+
+public:
+    explicit PerfScope(PerfKernelStats* stats) : stats(stats) {
+        if (stats != nullptr) {
+            ++stats->invocations;
+            active_perf_stats().store(stats, std::memory_order_release);
+            start = ThreadPerfCounters::current().read();
+        }
+    }
+
+    ~PerfScope() {
+        if (stats != nullptr) {
+            stats->add(0, ThreadPerfCounters::current().read() - start);
+            active_perf_stats().store(nullptr, std::memory_order_release);
+        }
+    }
+
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+};
+
+// Persistent work-stealing thread pool.
+// parallel_for() spreads task indices over one deque per worker; each worker pops from the back of its own
+// deque and, once it runs dry, steals from the front of the others. The calling thread acts as worker 0,
+// so a pool of N threads spawns N - 1 OS threads once and reuses them for every call.
+class ThreadPool {
+    // Each queued task carries its job so a worker that wakes late can never run it against the wrong function
+    struct Task {
+        const std::function<void(int)>* fn;
+        int index;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    bool pinned = false;
+
+    std::mutex submit_mutex;   // One parallel_for at a time
+    std::mutex state_mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    bool stopping = false;
+    std::atomic<int> remaining{0};
+
+    static bool& inside_worker() {
+        thread_local bool flag = false;
+        return flag;
+    }
+
+    static void pin_to_core(int core) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(core % std::max(1u, std::thread::hardware_concurrency()), &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+
+    bool pop_local(int w, Task& task) {
+        WorkQueue& queue = *queues[w];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            return false;
+        }
+        task = queue.tasks.back();
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(int w, Task& task) {
+        int n = static_cast<int>(queues.size());
+        for (int offset = 1; offset < n; ++offset) {
+            WorkQueue& victim = *queues[(w + offset) % n];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run_tasks(int w) {
+        Task task;
+        while (pop_local(w, task) || steal(w, task)) {
+            // Worker 0 is the caller, whose counts are already taken by the enclosing PerfScope
+            PerfKernelStats* stats = (w != 0) ? active_perf_stats().load(std::memory_order_acquire) : nullptr;
+            if (stats != nullptr) {
+                PerfSample before = ThreadPerfCounters::current().read();
+                (*task.fn)(task.index);
+                stats->add(w, ThreadPerfCounters::current().read() - before);
+            } else {
+                (*task.fn)(task.index);
+            }
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(state_mutex);
+                done.notify_all();
+            }
+        }
+    }
 
+    void worker_loop(int w) {
+        inside_worker() = true;
+        if (pinned) {
+            pin_to_core(w);
+        }
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(state_mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+            }
+            run_tasks(w);
+        }
+    }
+
+public:
+    explicit ThreadPool(int num_threads, bool pin_threads = false) : pinned(pin_threads) {
+        num_threads = std::max(num_threads, 1);
+        for (int w = 0; w < num_threads; ++w) {
+            queues.emplace_back(new WorkQueue());
+        }
+        for (int w = 1; w < num_threads; ++w) {
+            workers.emplace_back(&ThreadPool::worker_loop, this, w);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return static_cast<int>(queues.size()); }
+    bool pins_threads() const { return pinned; }
+
+    // Run fn(task) for every task in [0, num_tasks) and return once all of them have finished.
+    // Calls made from inside a task run serially on the calling worker.
+    void parallel_for(int num_tasks, const std::function<void(int)>& fn) {
+        if (num_tasks <= 0) {
+            return;
+        }
+        if (size() == 1 || num_tasks == 1 || inside_worker()) {
+            for (int t = 0; t < num_tasks; ++t) {
+                fn(t);
+            }
+            return;
+        }
+
+        std::lock_guard<std::mutex> submit_lock(submit_mutex);
+        remaining.store(num_tasks, std::memory_order_relaxed);
+
+        // Contiguous runs of tasks per worker keep neighbouring tiles on the same core until stolen
+        int n = size();
+        for (int w = 0; w < n; ++w) {
+            int begin = static_cast<int>(static_cast<long long>(num_tasks) * w / n);
+            int end = static_cast<int>(static_cast<long long>(num_tasks) * (w + 1) / n);
+            std::lock_guard<std::mutex> lock(queues[w]->mutex);
+            for (int t = begin; t < end; ++t) {
+                queues[w]->tasks.push_back(Task{&fn, t});
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            ++generation;
+        }
+        wake.notify_all();
+
+        inside_worker() = true;
+        run_tasks(0);
+        inside_worker() = false;
 
+        std::unique_lock<std::mutex> lock(state_mutex);
+        done.wait(lock, [&] { return remaining.load(std::memory_order_acquire) == 0; });
+    }
 
-// Define the matrix as a 2D vector
-typedef std::vector<std::vector<float>> Matrix;
+    // Split a rows x cols iteration space into tile_rows x tile_cols tiles and run
+    // fn(i_start, i_end, j_start, j_end) for each tile as a separate stealable task
+    void parallel_for_tiles(int rows, int cols, int tile_rows, int tile_cols,
+                            const std::function<void(int, int, int, int)>& fn) {
+        tile_rows = std::max(tile_rows, 1);
+        tile_cols = std::max(tile_cols, 1);
+        int tiles_i = (rows + tile_rows - 1) / tile_rows;
+        int tiles_j = (cols + tile_cols - 1) / tile_cols;
+        parallel_for(tiles_i * tiles_j, [&](int task) {
+            int i = task / tiles_j * tile_rows;
+            int j = task % tiles_j * tile_cols;
+            fn(i, std::min(i + tile_rows, rows), j, std::min(j + tile_cols, cols));
+        });
+    }
+};
 
-// Function to generate matrices
-Matrix generate_matrix(int rows, int cols, float sparsity);
+// Function to generate matrices (seed 0 draws a fresh seed from std::random_device)
+Matrix generate_matrix(int rows, int cols, float sparsity, unsigned seed = 0);
 
 // Function to multiply matrices without any optimization
 Matrix multiply_native(const Matrix& A, const Matrix& B);
@@ -27,11 +714,114 @@ Matrix multiply_simd(const Matrix& A, const Matrix& B);
 Matrix multiply_cache_optimized(const Matrix& A, const Matrix& B);
 
 // Helper function to perform block multiplication
-void block_multiply(const Matrix& A, const Matrix& B, Matrix& result, int i_start, int i_end, int j_start, int j_end, int k_start, int k_end);
+void block_multiply(ConstMatrixView A, ConstMatrixView B, MatrixView result, int i_start, int i_end, int j_start, int j_end, int k_start, int k_end);
+
+// Helper function to perform block multiplication with AVX2 (broadcast A, 8 columns of B at a time)
+void simd_block_multiply(ConstMatrixView A, ConstMatrixView B, MatrixView result, int i_start, int i_end, int j_start, int j_end, int k_start, int k_end);
+
+// Pick the widest GEMM microkernel supported by this CPU (checked once with CPUID)
+const GemmKernel& select_gemm_kernel();
+
+// Every GEMM microkernel this CPU can run, widest first
+const std::vector<GemmKernel>& available_gemm_kernels();
+
+// Packed, register-blocked GEMM: C += A * B
+void gemm_packed(ConstMatrixView A, ConstMatrixView B, MatrixView C, const GemmKernel& kernel);
+
+// Tile shape used when the row/column space of a product is split into pool tasks
+constexpr int TILE_ROWS = 64;
+constexpr int TILE_COLS = 256;
+
+// Pool shared by every kernel. Recreated only when a different thread count is requested or the pinning
+// setting has changed; num_threads <= 0 keeps the current pool (or uses all hardware threads for the first call).
+ThreadPool& shared_thread_pool(int num_threads);
 
-// Function to combine all optimizations
+// Whether the shared pool pins its workers to cores. The setting sticks until changed: kernels only ever ask
+// shared_thread_pool for a thread count, and the pool is rebuilt on its next use if the setting differs.
+void set_thread_pinning(bool pin_threads);
+
+// gemm_packed split into (i, j) tiles on the given pool: C += A * B
+void gemm_packed_parallel(ConstMatrixView A, ConstMatrixView B, MatrixView C, const GemmKernel& kernel, ThreadPool& pool);
+
+// Batch of independent small products: C[b] = A[b] * B[b] for b < batch_size, written into the caller's views.
+// Each product runs on a single pool worker with a kernel specialized for its shape when one exists; nothing is
+// allocated. num_threads <= 0 keeps the current pool. Returns false (and computes nothing) on a shape mismatch.
+bool gemm_batched(const ConstMatrixView* A, const ConstMatrixView* B, const MatrixView* C, int batch_size, int num_threads);
+
+// Fraction of nonzero entries in a matrix
+float measure_density(const Matrix& M);
+
+// Converters between the dense Matrix and the sparse formats
+CSRMatrix to_csr(const Matrix& M);
+CSCMatrix to_csc(const Matrix& M);
+BCSRMatrix to_bcsr(const Matrix& M, int block_rows, int block_cols);
+Matrix to_dense(const CSRMatrix& M);
+
+// Sparse x dense, dense x sparse and sparse x sparse kernels; cost scales with nnz instead of n^3
+Matrix multiply_csr_dense(const CSRMatrix& A, const Matrix& B);
+Matrix multiply_bcsr_dense(const BCSRMatrix& A, const Matrix& B);
+Matrix multiply_dense_csc(const Matrix& A, const CSCMatrix& B);
+CSRMatrix multiply_csr_csr(const CSRMatrix& A, const CSRMatrix& B);
+
+// Choose a sparse or dense kernel from the measured densities of A and B
+SparseKernel select_sparse_kernel(const Matrix& A, const Matrix& B);
+
+// Multiply with the kernel chosen by select_sparse_kernel, converting the operands as needed
+Matrix multiply_sparse_auto(const Matrix& A, const Matrix& B);
+
+// Cache-blocked multiplication of the result tile [i_start, i_end) x [j_start, j_end) with the given block loop order
+void blocked_multiply(ConstMatrixView A, ConstMatrixView B, MatrixView result, int i_start, int i_end, int j_start, int j_end,
+                      int block_size, BlockLoopOrder loop_order, bool use_simd);
+
+// Function to combine all optimizations (num_threads <= 0 uses the tuned thread count, if the profile has one)
 Matrix multiply_optimized(const Matrix& A, const Matrix& B, int num_threads, bool use_simd, bool use_cache_optimization);
 
+// multiply_optimized / multiply_cache_optimized with explicit parameters instead of the tuning profile
+Matrix multiply_optimized_with_params(const Matrix& A, const Matrix& B, int num_threads, bool use_simd, bool use_cache_optimization, const TuningParams& params);
+Matrix multiply_cache_optimized_with_params(const Matrix& A, const Matrix& B, const TuningParams& params);
+
+// Strassen-Winograd: C = A * B with 7 half-size products per level, handing off to the packed GEMM engine
+// once any dimension is at or below `cutoff` (<= 0 uses the tuned cutoff). Odd dimensions are peeled.
+Matrix multiply_strassen(const Matrix& A, const Matrix& B, int num_threads, int cutoff = 0);
+
+// Compare a Strassen-Winograd result and a classical result against a double-precision reference on sampled rows
+StrassenErrorReport strassen_error_report(const Matrix& A, const Matrix& B, const Matrix& C_strassen, const Matrix& C_classical,
+                                          int cutoff, int sample_rows);
+void print_strassen_error_report(const StrassenErrorReport& report);
+
+// Conversions between fp32 and the 16-bit storage formats (round to nearest even)
+BasicMatrix<bfloat16> to_bf16(const Matrix& M);
+BasicMatrix<float16> to_fp16(const Matrix& M);
+Matrix to_fp32(const BasicMatrix<bfloat16>& M);
+Matrix to_fp32(const BasicMatrix<float16>& M);
+
+// Symmetric int8 quantization with one scale per row (per_column = false) or per column, and its inverse
+QuantizedMatrix quantize_int8(const Matrix& M, bool per_column);
+Matrix dequantize_int8(const QuantizedMatrix& Q);
+
+// Reduced-precision products with an fp32 result: bf16 and fp16 accumulate in fp32, int8 in int32.
+// multiply_int8 expects A quantized per row and B per column.
+Matrix multiply_bf16(const BasicMatrix<bfloat16>& A, const BasicMatrix<bfloat16>& B);
+Matrix multiply_fp16(const BasicMatrix<float16>& A, const BasicMatrix<float16>& B);
+Matrix multiply_int8(const QuantizedMatrix& A, const QuantizedMatrix& B);
+
+// Run every reduced-precision kernel on A * B and compare it with multiply_native
+std::vector<PrecisionError> precision_accuracy_report(const Matrix& A, const Matrix& B);
+void print_precision_report(const std::vector<PrecisionError>& report);
+
+// CPU model from /proc/cpuinfo and the power-of-two shape bucket used as tuning profile keys
+std::string cpu_model_name();
+std::string shape_class(int m, int n, int k);
+
+// Profile file location: $GEMM_TUNING_PROFILE, or gemm_tuning.profile in the working directory
+std::string tuning_profile_path();
+
+// Profile loaded once from tuning_profile_path() on first use
+TuningProfile& tuning_profile();
+
+// Parameters for an m x k by k x n product on this CPU: the tuned entry if there is one, otherwise the defaults
+TuningParams tuned_params(int m, int n, int k);
+
 // Function to benchmark
 void benchmark(Matrix (*mult_func)(const Matrix&, const Matrix&), const Matrix& A, const Matrix& B, const std::string& label);
 
@@ -41,13 +831,32 @@ void benchmark_multithreading(const Matrix& A, const Matrix& B, const std::vecto
 // Function to benchmark all processes
 void benchmark_optimized(const Matrix& A, const Matrix& B, int num_threads, bool use_simd, bool use_cache_optimization);
 
+// Function to benchmark the automatically selected sparse kernel
+void benchmark_sparse(const Matrix& A, const Matrix& B);
+
+// Function to benchmark Strassen-Winograd against the classical packed kernel, with an error report
+void benchmark_strassen(const Matrix& A, const Matrix& B, int num_threads);
+
+// Function to benchmark the bf16, fp16 and int8 kernels, with an accuracy report against native fp32
+void benchmark_mixed_precision(const Matrix& A, const Matrix& B);
+
+// Function to benchmark a batch of size x size products: gemm_batched against one multiply_optimized call each
+void benchmark_batched(int size, int batch_size, int num_threads);
+
+// Non-interactive benchmark suite driven by command-line flags and/or a config file; returns the exit code
+int run_benchmark_suite(int argc, char** argv);
+
 
 
 
 
 
 int main(int argc, char** argv) {
-    // Parse command-line arguments for configurations
+    // Parse command-line arguments for configurations; without any, fall back to the interactive prompts
+    if (argc > 1) {
+        return run_benchmark_suite(argc, argv);
+    }
+
     int num_threads = 1; // default number of threads
     int matrix_size; 
     std::vector<int> thread_counts = {1, 2, 4, 8, 16, 32};
@@ -78,6 +887,10 @@ int main(int argc, char** argv) {
         std::cout << "3: SIMD " << std::endl; // Type a number and press enter
         std::cout << "4: Cache-Optimized " << std::endl; // Type a number and press enter
         std::cout << "5: All Optimizations " << std::endl; // Type a number and press enter
+        std::cout << "6: Sparse (kernel chosen from density) " << std::endl; // Type a number and press enter
+        std::cout << "7: Strassen-Winograd (with error report) " << std::endl; // Type a number and press enter
+        std::cout << "8: Mixed precision bf16 / fp16 / int8 (with accuracy report) " << std::endl; // Type a number and press enter
+        std::cout << "9: Batched small products (matrix size per product) " << std::endl; // Type a number and press enter
         std::cin >> usr_choice;
 
         std::cout << "Benchmarking Matrix of size: " << matrix_size << "x" << matrix_size << std::endl;
@@ -98,6 +911,21 @@ int main(int argc, char** argv) {
             use_simd = true;
             use_cache_optimization = true;
             benchmark_optimized(A, B, num_threads, use_simd, use_cache_optimization);
+        } else if (usr_choice == 6){
+            benchmark_sparse(A, B);
+        } else if (usr_choice == 7){
+            std::cout << "How many threads would you like to use? " << std::endl; // Type a number and press enter
+            std::cin >> num_threads;
+            benchmark_strassen(A, B, num_threads);
+        } else if (usr_choice == 8){
+            benchmark_mixed_precision(A, B);
+        } else if (usr_choice == 9){
+            int batch_size;
+            std::cout << "How many products are in the batch? " << std::endl; // Type a number and press enter
+            std::cin >> batch_size;
+            std::cout << "How many threads would you like to use? " << std::endl; // Type a number and press enter
+            std::cin >> num_threads;
+            benchmark_batched(matrix_size, batch_size, num_threads);
         }
         std::cout << "Would you like to end the program? y or n" << std::endl;
         std::cin >> check;
@@ -116,20 +944,97 @@ void benchmark_optimized(const Matrix& A, const Matrix& B, int num_threads, bool
     std::cout << "All optimizations " << ": " << elapsed.count() << " seconds" << std::endl;
 }
 
+void benchmark_sparse(const Matrix& A, const Matrix& B){
+    static const char* kernel_names[] = {"Dense (packed GEMM)", "CSR x Dense", "BCSR x Dense", "Dense x CSC", "CSR x CSR"};
+    SparseKernel kernel = select_sparse_kernel(A, B);
+    std::cout << "Density: A = " << measure_density(A) << " B = " << measure_density(B) << std::endl;
+    std::cout << "Selected kernel: " << kernel_names[static_cast<int>(kernel)] << std::endl;
+    benchmark(multiply_sparse_auto, A, B, "Sparse (including conversion)");
+}
+
+void benchmark_strassen(const Matrix& A, const Matrix& B, int num_threads){
+    auto start = std::chrono::high_resolution_clock::now();
+    Matrix strassen = multiply_strassen(A, B, num_threads);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+    std::cout << "Strassen-Winograd: " << elapsed.count() << " seconds" << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    Matrix classical = multiply_optimized(A, B, num_threads, true, true);
+    end = std::chrono::high_resolution_clock::now();
+    elapsed = end - start;
+    std::cout << "Classical (all optimizations): " << elapsed.count() << " seconds" << std::endl;
+
+    print_strassen_error_report(strassen_error_report(A, B, strassen, classical,
+        tuned_params(A.rows(), B.cols(), A.cols()).strassen_cutoff, 16));
+}
+
+void benchmark_mixed_precision(const Matrix& A, const Matrix& B){
+    print_precision_report(precision_accuracy_report(A, B));
+}
+
+void benchmark_batched(int size, int batch_size, int num_threads){
+    // The batch is stacked vertically in one matrix per operand; each product is a size x size block of it
+    Matrix A = generate_matrix(size * batch_size, size, 0.0f);
+    Matrix B = generate_matrix(size * batch_size, size, 0.0f);
+    Matrix C(size * batch_size, size);
+    std::vector<ConstMatrixView> A_views, B_views;
+    std::vector<MatrixView> C_views;
+    for (int b = 0; b < batch_size; ++b) {
+        A_views.push_back(A.block(b * size, 0, size, size));
+        B_views.push_back(B.block(b * size, 0, size, size));
+        C_views.push_back(C.block(b * size, 0, size, size));
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    gemm_batched(A_views.data(), B_views.data(), C_views.data(), batch_size, num_threads);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+    std::cout << "Batched (" << batch_size << " products): " << elapsed.count() << " seconds" << std::endl;
+
+    // What the batch replaces: a separate call, and a new result Matrix, per product
+    std::vector<Matrix> A_list, B_list, C_list;
+    for (int b = 0; b < batch_size; ++b) {
+        A_list.emplace_back(size, size);
+        B_list.emplace_back(size, size);
+        for (int i = 0; i < size; ++i) {
+            std::memcpy(A_list[b].row(i), A_views[b].row(i), size * sizeof(float));
+            std::memcpy(B_list[b].row(i), B_views[b].row(i), size * sizeof(float));
+        }
+    }
+    start = std::chrono::high_resolution_clock::now();
+    for (int b = 0; b < batch_size; ++b) {
+        C_list.push_back(multiply_optimized(A_list[b], B_list[b], num_threads, true, true));
+    }
+    end = std::chrono::high_resolution_clock::now();
+    elapsed = end - start;
+    std::cout << "One multiply_optimized call per product: " << elapsed.count() << " seconds" << std::endl;
+
+    double max_error = 0.0;
+    for (int b = 0; b < batch_size; ++b) {
+        for (int i = 0; i < size; ++i) {
+            for (int j = 0; j < size; ++j) {
+                max_error = std::max(max_error, static_cast<double>(std::fabs(C_list[b](i, j) - C_views[b](i, j))));
+            }
+        }
+    }
+    std::cout << "Max difference between the two: " << max_error << std::endl;
+}
+
 
 Matrix multiply_native(const Matrix& A, const Matrix& B) {
-    int rows_A = A.size();        // Number of rows in matrix A
-    int cols_A = A[0].size();     // Number of columns in matrix A
-    int cols_B = B[0].size();     // Number of columns in matrix B
+    int rows_A = A.rows();        // Number of rows in matrix A
+    int cols_A = A.cols();        // Number of columns in matrix A
+    int cols_B = B.cols();        // Number of columns in matrix B
 
     // Initialize result matrix with zeros
-    Matrix result(rows_A, std::vector<float>(cols_B, 0));
+    Matrix result(rows_A, cols_B);
 
-    // Perform the matrix multiplication: result[i][j] = sum(A[i][k] * B[k][j])
+    // Perform the matrix multiplication: result(i, j) = sum(A(i, k) * B(k, j))
     for (int i = 0; i < rows_A; ++i) {
         for (int j = 0; j < cols_B; ++j) {
             for (int k = 0; k < cols_A; ++k) {
-                result[i][j] += A[i][k] * B[k][j];
+                result(i, j) += A(i, k) * B(k, j);
             }
         }
     }
@@ -139,34 +1044,17 @@ Matrix multiply_native(const Matrix& A, const Matrix& B) {
 
 
 Matrix multiply_multithreaded(const Matrix& A, const Matrix& B, int num_threads) {
-    int rows_A = A.size();
-    int cols_A = A[0].size();
-    int cols_B = B[0].size();
-
-    Matrix result(rows_A, std::vector<float>(cols_B, 0));
+    int rows_A = A.rows();
+    int cols_A = A.cols();
+    int cols_B = B.cols();
 
-    auto worker = [&](int start_row, int end_row) {
-        for (int i = start_row; i < end_row; ++i) {
-            for (int k = 0; k < cols_A; ++k) {
-                for (int j = 0; j < cols_B; ++j) {
-                    result[i][j] += A[i][k] * B[k][j];
-                }
-            }
-        }
-    };
-
-    std::vector<std::thread> threads;
-    int rows_per_thread = rows_A / num_threads;
-
-    for (int t = 0; t < num_threads; ++t) {
-        int start_row = t * rows_per_thread;
-        int end_row = (t == num_threads - 1) ? rows_A : start_row + rows_per_thread;
-        threads.emplace_back(worker, start_row, end_row);
-    }
+    Matrix result(rows_A, cols_B);
 
-    for (auto& t : threads) {
-        t.join();
-    }
+    // Each (i, j) tile is an independent task on the shared work-stealing pool
+    shared_thread_pool(num_threads).parallel_for_tiles(rows_A, cols_B, TILE_ROWS, TILE_COLS,
+        [&](int i_start, int i_end, int j_start, int j_end) {
+            block_multiply(A.view(), B.view(), result.view(), i_start, i_end, j_start, j_end, 0, cols_A);
+        });
 
     return result;
 }
@@ -174,51 +1062,30 @@ Matrix multiply_multithreaded(const Matrix& A, const Matrix& B, int num_threads)
 
 
 Matrix multiply_simd(const Matrix& A, const Matrix& B) {
-    int rows_A = A.size();
-    int cols_A = A[0].size();
-    int cols_B = B[0].size();
+    int rows_A = A.rows();
+    int cols_A = A.cols();
+    int cols_B = B.cols();
 
-    Matrix result(rows_A, std::vector<float>(cols_B, 0));
+    Matrix result(rows_A, cols_B);
 
-    for (int i = 0; i < rows_A; i++) {
-        for (int j = 0; j < cols_B; j++) {
-            __m256 sum = _mm256_setzero_ps(); // SIMD sum
-            for (int k = 0; k < cols_A; k += 8) {
-                __m256 a = _mm256_loadu_ps(&A[i][k]);
-                __m256 b = _mm256_loadu_ps(&B[k][j]);
-                 sum = _mm256_fmadd_ps(a, b, sum); // SIMD fused multiply-add
-            }
-            float temp[8];
-            _mm256_storeu_ps(temp, sum);
-            result[i][j] = temp[0] + temp[1] + temp[2] + temp[3] + temp[4] + temp[5] + temp[6] + temp[7];
-        }
-    }
+    simd_block_multiply(A.view(), B.view(), result.view(), 0, rows_A, 0, cols_B, 0, cols_A);
 
     return result;
 }
 
 
 Matrix multiply_cache_optimized(const Matrix& A, const Matrix& B) {
-    int block_size = 64; // Choose an optimal block size based on cache size
-    int rows_A = A.size();
-    int cols_A = A[0].size();
-    int cols_B = B[0].size();
+    // Block size and loop order come from the tuning profile (64 and i-j-k blocks when untuned)
+    return multiply_cache_optimized_with_params(A, B, tuned_params(A.rows(), B.cols(), A.cols()));
+}
 
-    Matrix result(rows_A, std::vector<float>(cols_B, 0));
+Matrix multiply_cache_optimized_with_params(const Matrix& A, const Matrix& B, const TuningParams& params) {
+    int rows_A = A.rows();
+    int cols_B = B.cols();
 
-    for (int i = 0; i < rows_A; i += block_size) {
-        for (int j = 0; j < cols_B; j += block_size) {
-            for (int k = 0; k < cols_A; k += block_size) {
-                for (int ii = i; ii < std::min(i + block_size, rows_A); ++ii) {
-                    for (int kk = k; kk < std::min(k + block_size, cols_A); ++kk) {
-                        for (int jj = j; jj < std::min(j + block_size, cols_B); ++jj) {
-                            result[ii][jj] += A[ii][kk] * B[kk][jj];
-                        }
-                    }
-                }
-            }
-        }
-    }
+    Matrix result(rows_A, cols_B);
+
+    blocked_multiply(A.view(), B.view(), result.view(), 0, rows_A, 0, cols_B, params.block_size, params.loop_order, false);
 
     return result;
 }
@@ -247,19 +1114,19 @@ void benchmark_multithreading(const Matrix& A, const Matrix& B, const std::vecto
     }
 }
 
-Matrix generate_matrix(int rows, int cols, float sparsity) {
-    Matrix matrix(rows, std::vector<float>(cols, 0.0f));
+Matrix generate_matrix(int rows, int cols, float sparsity, unsigned seed) {
+    Matrix matrix(rows, cols);
 
     // Random number generator to populate matrix elements
     std::random_device rd;  // Seed
-    std::mt19937 gen(rd()); // Random number generator
+    std::mt19937 gen(seed != 0 ? seed : rd()); // Random number generator
     std::uniform_real_distribution<> dis(0.0, 1.0); // Distribution for sparsity
     std::uniform_real_distribution<> value_dis(-10.0, 10.0); // Distribution for values
 
     for (int i = 0; i < rows; ++i) {
         for (int j = 0; j < cols; ++j) {
             if (dis(gen) > sparsity) {
-                matrix[i][j] = value_dis(gen); // Assign random value to the matrix element
+                matrix(i, j) = value_dis(gen); // Assign random value to the matrix element
             }
         }
     }
@@ -268,11 +1135,15 @@ Matrix generate_matrix(int rows, int cols, float sparsity) {
 }
 
 // Helper function to perform block multiplication
-void block_multiply(const Matrix& A, const Matrix& B, Matrix& result, int i_start, int i_end, int j_start, int j_end, int k_start, int k_end) {
+void block_multiply(ConstMatrixView A, ConstMatrixView B, MatrixView result, int i_start, int i_end, int j_start, int j_end, int k_start, int k_end) {
     for (int i = i_start; i < i_end; ++i) {
+        float* result_row = result.row(i);
+        const float* a_row = A.row(i);
         for (int k = k_start; k < k_end; ++k) {
+            const float a_ik = a_row[k];
+            const float* b_row = B.row(k);
             for (int j = j_start; j < j_end; ++j) {
-                result[i][j] += A[i][k] * B[k][j];
+                result_row[j] += a_ik * b_row[j];
             }
         }
     }
@@ -280,65 +1151,2257 @@ void block_multiply(const Matrix& A, const Matrix& B, Matrix& result, int i_star
 
 // Optimized matrix multiplication function
 Matrix multiply_optimized(const Matrix& A, const Matrix& B, int num_threads, bool use_simd, bool use_cache_optimization) {
-    int rows_A = A.size();
-    int cols_A = A[0].size();
-    int cols_B = B[0].size();
+    TuningParams params = tuned_params(A.rows(), B.cols(), A.cols());
+    if (num_threads <= 0) {
+        num_threads = params.threads;
+    }
+    return multiply_optimized_with_params(A, B, num_threads, use_simd, use_cache_optimization, params);
+}
+
+// Copy of the named microkernel with the tuned MC/KC/NC applied
+static GemmKernel tuned_gemm_kernel(const TuningParams& params) {
+    GemmKernel kernel = select_gemm_kernel();
+    for (const auto& candidate : available_gemm_kernels()) {
+        if (params.kernel == candidate.name) {
+            kernel = candidate;
+        }
+    }
+    if (params.mc > 0) kernel.mc = std::max(params.mc / kernel.mr, 1) * kernel.mr;
+    if (params.kc > 0) kernel.kc = params.kc;
+    if (params.nc > 0) kernel.nc = std::max(params.nc / kernel.nr, 1) * kernel.nr;
+    return kernel;
+}
+
+Matrix multiply_optimized_with_params(const Matrix& A, const Matrix& B, int num_threads, bool use_simd, bool use_cache_optimization, const TuningParams& params) {
+    int rows_A = A.rows();
+    int cols_A = A.cols();
+    int cols_B = B.cols();
+
+    Matrix result(rows_A, cols_B);
+
+    ThreadPool& pool = shared_thread_pool(num_threads);
+
+    if (use_simd && use_cache_optimization) {
+        gemm_packed_parallel(A.view(), B.view(), result.view(), tuned_gemm_kernel(params), pool);
+        return result;
+    }
 
-    Matrix result(rows_A, std::vector<float>(cols_B, 0));
+    int block_size = use_cache_optimization ? params.block_size : std::max(cols_A, 1);
 
-    auto worker = [&](int start_row, int end_row) {
-        int block_size = use_cache_optimization ? 64 : cols_A;
+    // Distribute (i, j) tiles over the shared pool instead of spawning threads per call
+    pool.parallel_for_tiles(rows_A, cols_B, TILE_ROWS, TILE_COLS, [&](int i_start, int i_end, int j_start, int j_end) {
+        blocked_multiply(A.view(), B.view(), result.view(), i_start, i_end, j_start, j_end, block_size, params.loop_order, use_simd);
+    });
+
+    return result;
+}
+
+void gemm_packed_parallel(ConstMatrixView A, ConstMatrixView B, MatrixView C, const GemmKernel& kernel, ThreadPool& pool) {
+    // Packed GEMM engine per (i, j) tile: handles its own MC/KC/NC blocking and register tiling.
+    // Tiles are at most MC rows tall, but small enough that every worker gets a few of them.
+    int tile_rows = (A.rows + 2 * pool.size() - 1) / (2 * pool.size());
+    tile_rows = std::min(std::max((tile_rows + kernel.mr - 1) / kernel.mr * kernel.mr, kernel.mr), kernel.mc);
+    int tile_cols = kernel.nr * 16;
+
+    pool.parallel_for_tiles(A.rows, B.cols, tile_rows, tile_cols, [&](int i_start, int i_end, int j_start, int j_end) {
+        gemm_packed(A.block(i_start, 0, i_end - i_start, A.cols), B.block(0, j_start, A.cols, j_end - j_start),
+                    C.block(i_start, j_start, i_end - i_start, j_end - j_start), kernel);
+    });
+}
+
+void blocked_multiply(ConstMatrixView A, ConstMatrixView B, MatrixView result, int i_start, int i_end, int j_start, int j_end,
+                      int block_size, BlockLoopOrder loop_order, bool use_simd) {
+    const int cols_A = A.cols;
+    block_size = std::max(block_size, 1);
+
+    auto multiply_block = [&](int i, int j, int k) {
+        // Choose the appropriate sub-matrix bounds
+        int ii_end = std::min(i + block_size, i_end);
+        int jj_end = std::min(j + block_size, j_end);
+        int k_end = std::min(k + block_size, cols_A);
+
+        if (use_simd) {
+            // SIMD Optimized Block Multiplication
+            simd_block_multiply(A, B, result, i, ii_end, j, jj_end, k, k_end);
+        } else {
+            // Standard block multiplication
+            block_multiply(A, B, result, i, ii_end, j, jj_end, k, k_end);
+        }
+    };
 
-        for (int i = start_row; i < end_row; i += block_size) {
-            for (int j = 0; j < cols_B; j += block_size) {
+    for (int i = i_start; i < i_end; i += block_size) {
+        if (loop_order == BlockLoopOrder::IJK) {
+            for (int j = j_start; j < j_end; j += block_size) {
                 for (int k = 0; k < cols_A; k += block_size) {
-                    // Choose the appropriate sub-matrix bounds
-                    int i_end = std::min(i + block_size, rows_A);
-                    int j_end = std::min(j + block_size, cols_B);
-                    int k_end = std::min(k + block_size, cols_A);
-
-                    if (use_simd) {
-                        // SIMD Optimized Block Multiplication
-                        for (int ii = i; ii < i_end; ++ii) {
-                            for (int jj = j; jj < j_end; ++jj) {
-                                __m256 sum = _mm256_setzero_ps(); // SIMD sum
-                                for (int kk = k; kk < k_end; kk += 8) {
-                                    __m256 a = _mm256_loadu_ps(&A[ii][kk]);  // Load 8 elements from A
-                                    __m256 b = _mm256_loadu_ps(&B[kk][jj]);  // Load 8 elements from B
-                                    sum = _mm256_fmadd_ps(a, b, sum);        // Fused multiply-add
-                                }
-                                // Store the sum result
-                                float temp[8];
-                                _mm256_storeu_ps(temp, sum);
-                                result[ii][jj] += temp[0] + temp[1] + temp[2] + temp[3] + temp[4] + temp[5] + temp[6] + temp[7];
-                            }
-                        }
-                    } else {
-                        // Standard block multiplication
-                        block_multiply(A, B, result, i, i_end, j, j_end, k, k_end);
-                    }
+                    multiply_block(i, j, k);
+                }
+            }
+        } else {
+            for (int k = 0; k < cols_A; k += block_size) {
+                for (int j = j_start; j < j_end; j += block_size) {
+                    multiply_block(i, j, k);
                 }
             }
         }
-    };
+    }
+}
+
+// Helper function to perform block multiplication with AVX2
+void simd_block_multiply(ConstMatrixView A, ConstMatrixView B, MatrixView result, int i_start, int i_end, int j_start, int j_end, int k_start, int k_end) {
+    for (int i = i_start; i < i_end; ++i) {
+        float* result_row = result.row(i);
+        const float* a_row = A.row(i);
+        for (int k = k_start; k < k_end; ++k) {
+            __m256 a = _mm256_set1_ps(a_row[k]);   // Broadcast A(i, k)
+            const float* b_row = B.row(k);
+            int j = j_start;
+            for (; j + 8 <= j_end; j += 8) {
+                __m256 b = _mm256_loadu_ps(b_row + j);          // 8 consecutive columns of row k of B
+                __m256 c = _mm256_loadu_ps(result_row + j);
+                _mm256_storeu_ps(result_row + j, _mm256_fmadd_ps(a, b, c));
+            }
+            for (; j < j_end; ++j) {
+                result_row[j] += a_row[k] * b_row[j];
+            }
+        }
+    }
+}
+
 
-    // Create multiple threads to parallelize computation
-    std::vector<std::thread> threads;
-    int rows_per_thread = rows_A / num_threads;
+// AVX2 microkernel: 6x16 register tile (12 ymm accumulators)
+void gemm_micro_avx2_6x16(int kc, const float* a_pack, const float* b_pack, float* c, int ldc) {
+    __m256 acc[6][2];
+    #pragma GCC unroll 6
+    for (int r = 0; r < 6; ++r) {
+        acc[r][0] = _mm256_setzero_ps();
+        acc[r][1] = _mm256_setzero_ps();
+    }
 
-    for (int t = 0; t < num_threads; ++t) {
-        int start_row = t * rows_per_thread;
-        int end_row = (t == num_threads - 1) ? rows_A : start_row + rows_per_thread;
-        threads.emplace_back(worker, start_row, end_row);
+    for (int p = 0; p < kc; ++p) {
+        __m256 b0 = _mm256_load_ps(b_pack);
+        __m256 b1 = _mm256_load_ps(b_pack + 8);
+        #pragma GCC unroll 6
+        for (int r = 0; r < 6; ++r) {
+            __m256 a = _mm256_broadcast_ss(a_pack + r);
+            acc[r][0] = _mm256_fmadd_ps(a, b0, acc[r][0]);
+            acc[r][1] = _mm256_fmadd_ps(a, b1, acc[r][1]);
+        }
+        a_pack += 6;
+        b_pack += 16;
     }
 
-    // Join all threads
-    for (auto& t : threads) {
-        t.join();
+    #pragma GCC unroll 6
+    for (int r = 0; r < 6; ++r) {
+        float* c_row = c + static_cast<size_t>(r) * ldc;
+        _mm256_storeu_ps(c_row, _mm256_add_ps(_mm256_loadu_ps(c_row), acc[r][0]));
+        _mm256_storeu_ps(c_row + 8, _mm256_add_ps(_mm256_loadu_ps(c_row + 8), acc[r][1]));
     }
+}
 
-    return result;
+// AVX-512 microkernel: 14x32 register tile (28 zmm accumulators).
+// Compiled for AVX-512 regardless of the command-line flags and only called when CPUID reports it.
+__attribute__((target("avx512f,fma")))
+void gemm_micro_avx512_14x32(int kc, const float* a_pack, const float* b_pack, float* c, int ldc) {
+    __m512 acc[14][2];
+    #pragma GCC unroll 14
+    for (int r = 0; r < 14; ++r) {
+        acc[r][0] = _mm512_setzero_ps();
+        acc[r][1] = _mm512_setzero_ps();
+    }
+
+    for (int p = 0; p < kc; ++p) {
+        __m512 b0 = _mm512_load_ps(b_pack);
+        __m512 b1 = _mm512_load_ps(b_pack + 16);
+        #pragma GCC unroll 14
+        for (int r = 0; r < 14; ++r) {
+            __m512 a = _mm512_set1_ps(a_pack[r]);
+            acc[r][0] = _mm512_fmadd_ps(a, b0, acc[r][0]);
+            acc[r][1] = _mm512_fmadd_ps(a, b1, acc[r][1]);
+        }
+        a_pack += 14;
+        b_pack += 32;
+    }
+
+    #pragma GCC unroll 14
+    for (int r = 0; r < 14; ++r) {
+        float* c_row = c + static_cast<size_t>(r) * ldc;
+        _mm512_storeu_ps(c_row, _mm512_add_ps(_mm512_loadu_ps(c_row), acc[r][0]));
+        _mm512_storeu_ps(c_row + 16, _mm512_add_ps(_mm512_loadu_ps(c_row + 16), acc[r][1]));
+    }
 }
 
+// Size a cache block so that `bytes_per_unit * units` fills about half of a cache level
+static int fit_to_cache(long cache_bytes, long fallback_bytes, int bytes_per_unit, int multiple) {
+    long bytes = cache_bytes > 0 ? cache_bytes : fallback_bytes;
+    int units = static_cast<int>(bytes / 2 / bytes_per_unit);
+    units = units / multiple * multiple;
+    return std::max(units, multiple);
+}
 
+// Derive MC/KC/NC for a microkernel from the cache sizes the OS reports
+static GemmKernel make_gemm_kernel(const char* name, int mr, int nr, GemmMicroKernel micro) {
+    GemmKernel kernel;
+    kernel.name = name;
+    kernel.mr = mr;
+    kernel.nr = nr;
+    kernel.micro = micro;
+    // kc: one B micro-panel (kc x nr) plus one A micro-panel (kc x mr) in L1
+    kernel.kc = std::min(fit_to_cache(sysconf(_SC_LEVEL1_DCACHE_SIZE), 32 * 1024, (mr + nr) * sizeof(float), 8), 512);
+    // mc: the packed A block (mc x kc) in L2
+    kernel.mc = std::min(fit_to_cache(sysconf(_SC_LEVEL2_CACHE_SIZE), 1024 * 1024, kernel.kc * sizeof(float), mr), 40 * mr);
+    // nc: the packed B panel (kc x nc) in L3
+    kernel.nc = std::min(fit_to_cache(sysconf(_SC_LEVEL3_CACHE_SIZE), 8 * 1024 * 1024, kernel.kc * sizeof(float), nr), 256 * nr);
+    return kernel;
+}
 
+const std::vector<GemmKernel>& available_gemm_kernels() {
+    static const std::vector<GemmKernel> kernels = [] {
+        std::vector<GemmKernel> list;
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            list.push_back(make_gemm_kernel("avx512-14x32", 14, 32, gemm_micro_avx512_14x32));
+        }
+        list.push_back(make_gemm_kernel("avx2-6x16", 6, 16, gemm_micro_avx2_6x16));
+        return list;
+    }();
+    return kernels;
+}
+
+const GemmKernel& select_gemm_kernel() {
+    return available_gemm_kernels().front();
+}
+
+// Per-thread scratch space for packed panels (slots 0 and 1) and reduced-precision A strips (slot 2);
+// grows on demand and is reused across calls
+static float* gemm_workspace(int slot, size_t floats) {
+    struct Workspace {
+        std::unique_ptr<float[], void (*)(float*)> data{nullptr, [](float* p) { std::free(p); }};
+        size_t capacity = 0;
+    };
+    thread_local Workspace workspaces[3];
+    Workspace& ws = workspaces[slot];
+    if (ws.capacity < floats) {
+        size_t bytes = (floats * sizeof(float) + MATRIX_ALIGNMENT - 1) / MATRIX_ALIGNMENT * MATRIX_ALIGNMENT;
+        float* p = static_cast<float*>(std::aligned_alloc(MATRIX_ALIGNMENT, bytes));
+        if (p == nullptr) {
+            throw std::bad_alloc();
+        }
+        ws.data.reset(p);
+        ws.capacity = floats;
+    }
+    return ws.data.get();
+}
+
+// Pack an m x k block of A into consecutive mr-row micro-panels, each stored column by column.
+// Rows past the end of A are zero-filled so the microkernel never needs a bounds check.
+static void pack_A(ConstMatrixView A, int mr, float* dst) {
+    for (int i = 0; i < A.rows; i += mr) {
+        int rows = std::min(mr, A.rows - i);
+        for (int p = 0; p < A.cols; ++p) {
+            for (int r = 0; r < rows; ++r) {
+                dst[r] = A(i + r, p);
+            }
+            for (int r = rows; r < mr; ++r) {
+                dst[r] = 0.0f;
+            }
+            dst += mr;
+        }
+    }
+}
+
+// Pack a k x n block of B into consecutive nr-column micro-panels, each stored row by row.
+static void pack_B(ConstMatrixView B, int nr, float* dst) {
+    for (int j = 0; j < B.cols; j += nr) {
+        int cols = std::min(nr, B.cols - j);
+        for (int p = 0; p < B.rows; ++p) {
+            const float* b_row = B.row(p) + j;
+            std::memcpy(dst, b_row, cols * sizeof(float));
+            for (int c = cols; c < nr; ++c) {
+                dst[c] = 0.0f;
+            }
+            dst += nr;
+        }
+    }
+}
+
+// Packed GEMM (GotoBLAS loop order): C += A * B
+void gemm_packed(ConstMatrixView A, ConstMatrixView B, MatrixView C, const GemmKernel& kernel) {
+    const int m = A.rows;
+    const int k = A.cols;
+    const int n = B.cols;
+    const int mr = kernel.mr;
+    const int nr = kernel.nr;
+    if (m == 0 || n == 0 || k == 0) {
+        return;
+    }
+
+    const int mc_max = (std::min(kernel.mc, m) + mr - 1) / mr * mr;
+    const int nc_max = (std::min(kernel.nc, n) + nr - 1) / nr * nr;
+    const int kc_max = std::min(kernel.kc, k);
+    float* a_pack = gemm_workspace(0, static_cast<size_t>(mc_max) * kc_max);
+    float* b_pack = gemm_workspace(1, static_cast<size_t>(nc_max) * kc_max);
+
+    // Scratch tile for partial micro-tiles at the right and bottom edges
+    alignas(MATRIX_ALIGNMENT) float edge_tile[14 * 32];
+
+    for (int jc = 0; jc < n; jc += kernel.nc) {
+        int nc = std::min(kernel.nc, n - jc);
+        for (int pc = 0; pc < k; pc += kernel.kc) {
+            int kc = std::min(kernel.kc, k - pc);
+            pack_B(B.block(pc, jc, kc, nc), nr, b_pack);
+
+            for (int ic = 0; ic < m; ic += kernel.mc) {
+                int mc = std::min(kernel.mc, m - ic);
+                pack_A(A.block(ic, pc, mc, kc), mr, a_pack);
+
+                for (int jr = 0; jr < nc; jr += nr) {
+                    int n_sub = std::min(nr, nc - jr);
+                    const float* b_panel = b_pack + static_cast<size_t>(jr) * kc;
+                    for (int ir = 0; ir < mc; ir += mr) {
+                        int m_sub = std::min(mr, mc - ir);
+                        const float* a_panel = a_pack + static_cast<size_t>(ir) * kc;
+                        float* c = &C(ic + ir, jc + jr);
+
+                        if (m_sub == mr && n_sub == nr) {
+                            kernel.micro(kc, a_panel, b_panel, c, C.ld);
+                        } else {
+                            std::memset(edge_tile, 0, sizeof(float) * mr * nr);
+                            kernel.micro(kc, a_panel, b_panel, edge_tile, nr);
+                            for (int r = 0; r < m_sub; ++r) {
+                                for (int col = 0; col < n_sub; ++col) {
+                                    c[static_cast<size_t>(r) * C.ld + col] += edge_tile[r * nr + col];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+// Register tile of the small-matrix kernels: R rows x 16 columns of C (R x 2 ymm accumulators), computed over the
+// whole k range straight from the unpacked operands. K > 0 fixes the depth at compile time (k is then ignored);
+// MASKED loads and stores only the columns enabled in `mask`, for the last column tile of an odd-width product.
+template <int R, int K, bool MASKED>
+static inline void gemm_small_tile(const float* a, int lda, const float* b, int ldb, float* c, int ldc, int k, const __m256i* mask) {
+    const int depth = K > 0 ? K : k;
+    __m256 acc[R][2];
+#pragma GCC unroll 6
+    for (int r = 0; r < R; ++r) {
+        acc[r][0] = _mm256_setzero_ps();
+        acc[r][1] = _mm256_setzero_ps();
+    }
+    for (int p = 0; p < depth; ++p) {
+        const float* b_row = b + static_cast<size_t>(p) * ldb;
+        __m256 b0 = MASKED ? _mm256_maskload_ps(b_row, mask[0]) : _mm256_loadu_ps(b_row);
+        __m256 b1 = MASKED ? _mm256_maskload_ps(b_row + 8, mask[1]) : _mm256_loadu_ps(b_row + 8);
+#pragma GCC unroll 6
+        for (int r = 0; r < R; ++r) {
+            __m256 a_vec = _mm256_broadcast_ss(a + static_cast<size_t>(r) * lda + p);
+            acc[r][0] = _mm256_fmadd_ps(a_vec, b0, acc[r][0]);
+            acc[r][1] = _mm256_fmadd_ps(a_vec, b1, acc[r][1]);
+        }
+    }
+#pragma GCC unroll 6
+    for (int r = 0; r < R; ++r) {
+        float* c_row = c + static_cast<size_t>(r) * ldc;
+        if (MASKED) {
+            _mm256_maskstore_ps(c_row, mask[0], acc[r][0]);
+            _mm256_maskstore_ps(c_row + 8, mask[1], acc[r][1]);
+        } else {
+            _mm256_storeu_ps(c_row, acc[r][0]);
+            _mm256_storeu_ps(c_row + 8, acc[r][1]);
+        }
+    }
+}
+
+// Rows per register tile of the small-matrix kernels (12 of the 16 ymm registers hold accumulators)
+constexpr int SMALL_GEMM_ROWS = 6;
+
+// C = A * B for one compile-time shape: every loop bound is a constant, so the row tail is resolved at
+// compile time and short k loops unroll completely
+template <int M, int N, int K>
+static void gemm_small_fixed(ConstMatrixView A, ConstMatrixView B, MatrixView C) {
+    static_assert(N % 16 == 0, "fixed small kernels cover whole 16-column tiles");
+    constexpr int full_rows = M / SMALL_GEMM_ROWS * SMALL_GEMM_ROWS;
+    constexpr int tail_rows = M - full_rows;
+    for (int j = 0; j < N; j += 16) {
+        for (int i = 0; i < full_rows; i += SMALL_GEMM_ROWS) {
+            gemm_small_tile<SMALL_GEMM_ROWS, K, false>(A.row(i), A.ld, B.data + j, B.ld, C.row(i) + j, C.ld, K, nullptr);
+        }
+        if constexpr (tail_rows > 0) {
+            gemm_small_tile<tail_rows, K, false>(A.row(full_rows), A.ld, B.data + j, B.ld, C.row(full_rows) + j, C.ld, K, nullptr);
+        }
+    }
+}
+
+// Tail of gemm_small_generic: a tile of 1..SMALL_GEMM_ROWS - 1 rows
+template <bool MASKED>
+static void gemm_small_tail(int rows, const float* a, int lda, const float* b, int ldb, float* c, int ldc, int k, const __m256i* mask) {
+    switch (rows) {
+        case 1: gemm_small_tile<1, 0, MASKED>(a, lda, b, ldb, c, ldc, k, mask); break;
+        case 2: gemm_small_tile<2, 0, MASKED>(a, lda, b, ldb, c, ldc, k, mask); break;
+        case 3: gemm_small_tile<3, 0, MASKED>(a, lda, b, ldb, c, ldc, k, mask); break;
+        case 4: gemm_small_tile<4, 0, MASKED>(a, lda, b, ldb, c, ldc, k, mask); break;
+        case 5: gemm_small_tile<5, 0, MASKED>(a, lda, b, ldb, c, ldc, k, mask); break;
+    }
+}
+
+// C = A * B for any shape, with the same register tile and masked edge columns
+static void gemm_small_generic(ConstMatrixView A, ConstMatrixView B, MatrixView C) {
+    const int m = A.rows;
+    const int k = A.cols;
+    const int n = B.cols;
+    const int full_rows = m / SMALL_GEMM_ROWS * SMALL_GEMM_ROWS;
+    for (int j = 0; j < n; j += 16) {
+        const int cols = std::min(16, n - j);
+        const float* b = B.data + j;
+        if (cols == 16) {
+            for (int i = 0; i < full_rows; i += SMALL_GEMM_ROWS) {
+                gemm_small_tile<SMALL_GEMM_ROWS, 0, false>(A.row(i), A.ld, b, B.ld, C.row(i) + j, C.ld, k, nullptr);
+            }
+            gemm_small_tail<false>(m - full_rows, A.row(full_rows), A.ld, b, B.ld, C.row(full_rows) + j, C.ld, k, nullptr);
+        } else {
+            const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            const __m256i mask[2] = {_mm256_cmpgt_epi32(_mm256_set1_epi32(cols), lane),
+                                     _mm256_cmpgt_epi32(_mm256_set1_epi32(cols - 8), lane)};
+            for (int i = 0; i < full_rows; i += SMALL_GEMM_ROWS) {
+                gemm_small_tile<SMALL_GEMM_ROWS, 0, true>(A.row(i), A.ld, b, B.ld, C.row(i) + j, C.ld, k, mask);
+            }
+            gemm_small_tail<true>(m - full_rows, A.row(full_rows), A.ld, b, B.ld, C.row(full_rows) + j, C.ld, k, mask);
+        }
+    }
+}
+
+// Products past the small range still go through the packed engine, on the calling worker only
+static void gemm_large_single(ConstMatrixView A, ConstMatrixView B, MatrixView C) {
+    for (int i = 0; i < C.rows; ++i) {
+        std::memset(C.row(i), 0, C.cols * sizeof(float));
+    }
+    gemm_packed(A, B, C, select_gemm_kernel());
+}
+
+// Above this many multiply-adds a product is no longer "small": its operands outgrow L2 without packing
+constexpr double SMALL_GEMM_MAX_MACS = 256.0 * 256.0 * 256.0;
+
+typedef void (*SmallGemmKernel)(ConstMatrixView A, ConstMatrixView B, MatrixView C);
+
+// Compile-time specialized kernel for an m x k by k x n product, gemm_small_generic for other small shapes
+// and gemm_large_single for large ones
+static SmallGemmKernel small_gemm_kernel(int m, int n, int k) {
+    struct Entry {
+        int m, n, k;
+        SmallGemmKernel kernel;
+    };
+    static const Entry fixed[] = {
+        {16, 16, 16, gemm_small_fixed<16, 16, 16>},
+        {32, 32, 32, gemm_small_fixed<32, 32, 32>},
+        {48, 48, 48, gemm_small_fixed<48, 48, 48>},
+        {64, 64, 64, gemm_small_fixed<64, 64, 64>},
+        {96, 96, 96, gemm_small_fixed<96, 96, 96>},
+        {128, 128, 128, gemm_small_fixed<128, 128, 128>},
+    };
+    for (const Entry& entry : fixed) {
+        if (entry.m == m && entry.n == n && entry.k == k) {
+            return entry.kernel;
+        }
+    }
+    if (static_cast<double>(m) * n * k > SMALL_GEMM_MAX_MACS) {
+        return gemm_large_single;
+    }
+    return gemm_small_generic;
+}
+
+// Below this many flops per pool task, consecutive products of a batch are grouped into one task
+constexpr double BATCH_TASK_FLOPS = 1 << 20;
+
+bool gemm_batched(const ConstMatrixView* A, const ConstMatrixView* B, const MatrixView* C, int batch_size, int num_threads) {
+    double total_flops = 0.0;
+    for (int b = 0; b < batch_size; ++b) {
+        if (A[b].cols != B[b].rows || C[b].rows != A[b].rows || C[b].cols != B[b].cols) {
+            std::cerr << "Error: gemm_batched: shape mismatch in product " << b << std::endl;
+            return false;
+        }
+        total_flops += 2.0 * A[b].rows * A[b].cols * B[b].cols;
+    }
+    if (batch_size <= 0) {
+        return true;
+    }
+
+    // Group products so a task carries about BATCH_TASK_FLOPS, but keep a few tasks per worker for stealing
+    ThreadPool& pool = shared_thread_pool(num_threads);
+    double average_flops = std::max(total_flops / batch_size, 1.0);
+    int per_task = std::max(1, static_cast<int>(BATCH_TASK_FLOPS / average_flops));
+    per_task = std::min(per_task, std::max(1, batch_size / (4 * pool.size())));
+    int num_tasks = (batch_size + per_task - 1) / per_task;
+
+    pool.parallel_for(num_tasks, [&](int t) {
+        int end = std::min(batch_size, (t + 1) * per_task);
+        for (int b = t * per_task; b < end; ++b) {
+            if (C[b].rows == 0 || C[b].cols == 0) {
+                continue;
+            }
+            small_gemm_kernel(A[b].rows, B[b].cols, A[b].cols)(A[b], B[b], C[b]);
+        }
+    });
+    return true;
+}
+
+
+// Densities below this are treated as sparse by select_sparse_kernel
+constexpr float SPARSE_DENSITY_THRESHOLD = 0.10f;
+// Both operands must be at least this sparse for sparse x sparse to beat sparse x dense
+constexpr float SPGEMM_DENSITY_THRESHOLD = 0.02f;
+// BCSR tile shape and the minimum fraction of stored tile entries that must be nonzero
+constexpr int BCSR_BLOCK_ROWS = 4;
+constexpr int BCSR_BLOCK_COLS = 8;
+constexpr float BCSR_MIN_FILL = 0.5f;
+
+float measure_density(const Matrix& M) {
+    if (M.rows() == 0 || M.cols() == 0) {
+        return 0.0f;
+    }
+    size_t nnz = 0;
+    for (int i = 0; i < M.rows(); ++i) {
+        const float* row = M.row(i);
+        for (int j = 0; j < M.cols(); ++j) {
+            nnz += (row[j] != 0.0f);
+        }
+    }
+    return static_cast<float>(static_cast<double>(nnz) / (static_cast<double>(M.rows()) * M.cols()));
+}
+
+CSRMatrix to_csr(const Matrix& M) {
+    CSRMatrix csr;
+    csr.rows = M.rows();
+    csr.cols = M.cols();
+    csr.row_ptr.reserve(csr.rows + 1);
+    csr.row_ptr.push_back(0);
+    for (int i = 0; i < M.rows(); ++i) {
+        const float* row = M.row(i);
+        for (int j = 0; j < M.cols(); ++j) {
+            if (row[j] != 0.0f) {
+                csr.col_idx.push_back(j);
+                csr.values.push_back(row[j]);
+            }
+        }
+        csr.row_ptr.push_back(static_cast<int>(csr.values.size()));
+    }
+    return csr;
+}
+
+CSCMatrix to_csc(const Matrix& M) {
+    CSCMatrix csc;
+    csc.rows = M.rows();
+    csc.cols = M.cols();
+    csc.col_ptr.assign(csc.cols + 1, 0);
+
+    // Count the nonzeros of each column, then scatter row by row so row indices stay sorted
+    for (int i = 0; i < M.rows(); ++i) {
+        const float* row = M.row(i);
+        for (int j = 0; j < M.cols(); ++j) {
+            csc.col_ptr[j + 1] += (row[j] != 0.0f);
+        }
+    }
+    for (int j = 0; j < csc.cols; ++j) {
+        csc.col_ptr[j + 1] += csc.col_ptr[j];
+    }
+
+    csc.row_idx.resize(csc.col_ptr[csc.cols]);
+    csc.values.resize(csc.col_ptr[csc.cols]);
+    std::vector<int> next(csc.col_ptr.begin(), csc.col_ptr.end() - 1);
+    for (int i = 0; i < M.rows(); ++i) {
+        const float* row = M.row(i);
+        for (int j = 0; j < M.cols(); ++j) {
+            if (row[j] != 0.0f) {
+                int pos = next[j]++;
+                csc.row_idx[pos] = i;
+                csc.values[pos] = row[j];
+            }
+        }
+    }
+    return csc;
+}
+
+BCSRMatrix to_bcsr(const Matrix& M, int block_rows, int block_cols) {
+    BCSRMatrix bcsr;
+    bcsr.rows = M.rows();
+    bcsr.cols = M.cols();
+    bcsr.block_rows = block_rows;
+    bcsr.block_cols = block_cols;
+    bcsr.block_row_ptr.push_back(0);
+
+    for (int bi = 0; bi < M.rows(); bi += block_rows) {
+        int rows = std::min(block_rows, M.rows() - bi);
+        for (int bj = 0; bj < M.cols(); bj += block_cols) {
+            int cols = std::min(block_cols, M.cols() - bj);
+
+            bool nonzero = false;
+            for (int r = 0; r < rows && !nonzero; ++r) {
+                const float* row = M.row(bi + r) + bj;
+                for (int c = 0; c < cols; ++c) {
+                    if (row[c] != 0.0f) {
+                        nonzero = true;
+                        break;
+                    }
+                }
+            }
+            if (!nonzero) {
+                continue;
+            }
+
+            bcsr.block_col_idx.push_back(bj / block_cols);
+            size_t base = bcsr.blocks.size();
+            bcsr.blocks.resize(base + static_cast<size_t>(block_rows) * block_cols, 0.0f);
+            for (int r = 0; r < rows; ++r) {
+                std::memcpy(&bcsr.blocks[base + static_cast<size_t>(r) * block_cols], M.row(bi + r) + bj, cols * sizeof(float));
+            }
+        }
+        bcsr.block_row_ptr.push_back(static_cast<int>(bcsr.block_col_idx.size()));
+    }
+    return bcsr;
+}
+
+Matrix to_dense(const CSRMatrix& M) {
+    Matrix dense(M.rows, M.cols);
+    for (int i = 0; i < M.rows; ++i) {
+        float* row = dense.row(i);
+        for (int p = M.row_ptr[i]; p < M.row_ptr[i + 1]; ++p) {
+            row[M.col_idx[p]] = M.values[p];
+        }
+    }
+    return dense;
+}
+
+// y[0:n] += a * x[0:n]
+static void axpy_row(float a, const float* x, float* y, int n) {
+    __m256 a_vec = _mm256_set1_ps(a);
+    int j = 0;
+    for (; j + 8 <= n; j += 8) {
+        _mm256_storeu_ps(y + j, _mm256_fmadd_ps(a_vec, _mm256_loadu_ps(x + j), _mm256_loadu_ps(y + j)));
+    }
+    for (; j < n; ++j) {
+        y[j] += a * x[j];
+    }
+}
+
+// Row i of the result is the sum of B's rows scaled by the nonzeros of row i of A
+Matrix multiply_csr_dense(const CSRMatrix& A, const Matrix& B) {
+    Matrix result(A.rows, B.cols());
+    shared_thread_pool(0).parallel_for_tiles(A.rows, B.cols(), TILE_ROWS, TILE_COLS, [&](int i_start, int i_end, int j_start, int j_end) {
+        for (int i = i_start; i < i_end; ++i) {
+            float* result_row = result.row(i) + j_start;
+            for (int p = A.row_ptr[i]; p < A.row_ptr[i + 1]; ++p) {
+                axpy_row(A.values[p], B.row(A.col_idx[p]) + j_start, result_row, j_end - j_start);
+            }
+        }
+    });
+    return result;
+}
+
+// Each stored tile multiplies block_cols rows of B into block_rows rows of the result
+Matrix multiply_bcsr_dense(const BCSRMatrix& A, const Matrix& B) {
+    Matrix result(A.rows, B.cols());
+    const int tile = A.block_rows * A.block_cols;
+    const int block_row_count = static_cast<int>(A.block_row_ptr.size()) - 1;
+    shared_thread_pool(0).parallel_for(block_row_count, [&](int bi) {
+        int row_start = bi * A.block_rows;
+        int rows = std::min(A.block_rows, A.rows - row_start);
+        for (int p = A.block_row_ptr[bi]; p < A.block_row_ptr[bi + 1]; ++p) {
+            int col_start = A.block_col_idx[p] * A.block_cols;
+            int cols = std::min(A.block_cols, A.cols - col_start);
+            const float* block = &A.blocks[static_cast<size_t>(p) * tile];
+            for (int r = 0; r < rows; ++r) {
+                float* result_row = result.row(row_start + r);
+                for (int c = 0; c < cols; ++c) {
+                    float a = block[r * A.block_cols + c];
+                    if (a != 0.0f) {
+                        axpy_row(a, B.row(col_start + c), result_row, B.cols());
+                    }
+                }
+            }
+        }
+    });
+    return result;
+}
+
+// result(i, j) is a sparse dot product: gather A(i, row_idx[..]) and multiply by column j's values
+Matrix multiply_dense_csc(const Matrix& A, const CSCMatrix& B) {
+    Matrix result(A.rows(), B.cols);
+    shared_thread_pool(0).parallel_for_tiles(A.rows(), B.cols, TILE_ROWS, TILE_COLS, [&](int i_start, int i_end, int j_start, int j_end) {
+        for (int i = i_start; i < i_end; ++i) {
+            const float* a_row = A.row(i);
+            float* result_row = result.row(i);
+            for (int j = j_start; j < j_end; ++j) {
+                int p = B.col_ptr[j];
+                const int end = B.col_ptr[j + 1];
+                __m256 sum = _mm256_setzero_ps();
+                for (; p + 8 <= end; p += 8) {
+                    __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&B.row_idx[p]));
+                    __m256 a = _mm256_i32gather_ps(a_row, idx, sizeof(float));
+                    sum = _mm256_fmadd_ps(a, _mm256_loadu_ps(&B.values[p]), sum);
+                }
+                __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+                half = _mm_hadd_ps(half, half);
+                half = _mm_hadd_ps(half, half);
+                float total = _mm_cvtss_f32(half);
+                for (; p < end; ++p) {
+                    total += a_row[B.row_idx[p]] * B.values[p];
+                }
+                result_row[j] = total;
+            }
+        }
+    });
+    return result;
+}
+
+// Gustavson row-by-row SpGEMM with a dense accumulator.
+// The accumulator row and its occupancy flags are reused across rows; a row's nonzeros are collected
+// either by sorting the touched columns (few touched) or by a SIMD scan of the flags (many touched).
+CSRMatrix multiply_csr_csr(const CSRMatrix& A, const CSRMatrix& B) {
+    CSRMatrix result;
+    result.rows = A.rows;
+    result.cols = B.cols;
+    result.row_ptr.reserve(A.rows + 1);
+    result.row_ptr.push_back(0);
+
+    std::vector<float> accumulator(B.cols, 0.0f);
+    std::vector<uint8_t> occupied(B.cols + 32, 0);   // Padded so the flag scan can read whole vectors
+    std::vector<int> touched;
+
+    for (int i = 0; i < A.rows; ++i) {
+        touched.clear();
+        for (int p = A.row_ptr[i]; p < A.row_ptr[i + 1]; ++p) {
+            const float a = A.values[p];
+            const int k = A.col_idx[p];
+            for (int q = B.row_ptr[k]; q < B.row_ptr[k + 1]; ++q) {
+                const int j = B.col_idx[q];
+                if (!occupied[j]) {
+                    occupied[j] = 1;
+                    touched.push_back(j);
+                }
+                accumulator[j] += a * B.values[q];
+            }
+        }
+
+        auto emit = [&](int j) {
+            result.col_idx.push_back(j);
+            result.values.push_back(accumulator[j]);
+            accumulator[j] = 0.0f;
+            occupied[j] = 0;
+        };
+
+        if (touched.size() * 32 < static_cast<size_t>(B.cols)) {
+            std::sort(touched.begin(), touched.end());
+            for (int j : touched) {
+                emit(j);
+            }
+        } else {
+            for (int base = 0; base < B.cols; base += 32) {
+                __m256i flags = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&occupied[base]));
+                uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(flags, _mm256_setzero_si256())));
+                while (mask != 0) {
+                    emit(base + __builtin_ctz(mask));
+                    mask &= mask - 1;
+                }
+            }
+        }
+        result.row_ptr.push_back(static_cast<int>(result.values.size()));
+    }
+    return result;
+}
+
+SparseKernel select_sparse_kernel(const Matrix& A, const Matrix& B) {
+    float density_A = measure_density(A);
+    float density_B = measure_density(B);
+
+    if (density_A < SPGEMM_DENSITY_THRESHOLD && density_B < SPGEMM_DENSITY_THRESHOLD) {
+        return SparseKernel::CSRxCSR;
+    }
+    if (density_A < SPARSE_DENSITY_THRESHOLD && density_A <= density_B) {
+        // Prefer BCSR when the nonzeros fill most of the tiles they touch
+        BCSRMatrix bcsr = to_bcsr(A, BCSR_BLOCK_ROWS, BCSR_BLOCK_COLS);
+        double stored = static_cast<double>(bcsr.num_blocks()) * BCSR_BLOCK_ROWS * BCSR_BLOCK_COLS;
+        double nnz = static_cast<double>(density_A) * A.rows() * A.cols();
+        if (stored > 0 && nnz / stored >= BCSR_MIN_FILL) {
+            return SparseKernel::BCSRxDense;
+        }
+        return SparseKernel::CSRxDense;
+    }
+    if (density_B < SPARSE_DENSITY_THRESHOLD) {
+        return SparseKernel::DensexCSC;
+    }
+    return SparseKernel::Dense;
+}
+
+Matrix multiply_sparse_auto(const Matrix& A, const Matrix& B) {
+    switch (select_sparse_kernel(A, B)) {
+        case SparseKernel::CSRxCSR:
+            return to_dense(multiply_csr_csr(to_csr(A), to_csr(B)));
+        case SparseKernel::CSRxDense:
+            return multiply_csr_dense(to_csr(A), B);
+        case SparseKernel::BCSRxDense:
+            return multiply_bcsr_dense(to_bcsr(A, BCSR_BLOCK_ROWS, BCSR_BLOCK_COLS), B);
+        case SparseKernel::DensexCSC:
+            return multiply_dense_csc(A, to_csc(B));
+        case SparseKernel::Dense:
+        default:
+            break;
+    }
+    return multiply_optimized(A, B, 0, true, true);
+}
+
+static std::mutex shared_pool_mutex;
+static bool shared_pool_pinning = false;
+
+void set_thread_pinning(bool pin_threads) {
+    std::lock_guard<std::mutex> lock(shared_pool_mutex);
+    shared_pool_pinning = pin_threads;
+}
+
+ThreadPool& shared_thread_pool(int num_threads) {
+    static std::unique_ptr<ThreadPool> pool;
+    std::lock_guard<std::mutex> lock(shared_pool_mutex);
+    if (num_threads <= 0) {
+        num_threads = pool ? pool->size() : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    if (!pool || pool->size() != num_threads || pool->pins_threads() != shared_pool_pinning) {
+        pool.reset();
+        pool.reset(new ThreadPool(num_threads, shared_pool_pinning));
+    }
+    return *pool;
+}
+
+
+std::string cpu_model_name() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.compare(0, 10, "model name") == 0) {
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                size_t start = line.find_first_not_of(" \t", colon + 1);
+                return start == std::string::npos ? "unknown-cpu" : line.substr(start);
+            }
+        }
+    }
+    return "unknown-cpu";
+}
+
+// Round each dimension up to a power of two (at least 64) so nearby shapes share one profile entry
+std::string shape_class(int m, int n, int k) {
+    auto bucket = [](int x) {
+        int b = 64;
+        while (b < x) {
+            b *= 2;
+        }
+        return b;
+    };
+    return "m" + std::to_string(bucket(m)) + "_n" + std::to_string(bucket(n)) + "_k" + std::to_string(bucket(k));
+}
+
+std::string tuning_profile_path() {
+    const char* path = std::getenv("GEMM_TUNING_PROFILE");
+    return (path != nullptr && *path != '\0') ? path : "gemm_tuning.profile";
+}
+
+// Line format: <cpu model> TAB <shape class> TAB kernel=.. mc=.. kc=.. nc=.. block=.. order=ijk|ikj threads=.. cutoff=..
+bool TuningProfile::load(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        size_t tab1 = line.find('\t');
+        size_t tab2 = (tab1 == std::string::npos) ? std::string::npos : line.find('\t', tab1 + 1);
+        if (tab2 == std::string::npos) {
+            continue;
+        }
+        TuningParams params;
+        std::stringstream fields(line.substr(tab2 + 1));
+        std::string field;
+        try {
+            while (fields >> field) {
+                size_t eq = field.find('=');
+                std::string key = field.substr(0, eq);
+                std::string value = (eq == std::string::npos) ? "" : field.substr(eq + 1);
+                if (key == "kernel") params.kernel = value;
+                else if (key == "mc") params.mc = std::stoi(value);
+                else if (key == "kc") params.kc = std::stoi(value);
+                else if (key == "nc") params.nc = std::stoi(value);
+                else if (key == "block") params.block_size = std::max(1, std::stoi(value));
+                else if (key == "order") params.loop_order = (value == "ikj") ? BlockLoopOrder::IKJ : BlockLoopOrder::IJK;
+                else if (key == "threads") params.threads = std::stoi(value);
+                else if (key == "cutoff") params.strassen_cutoff = std::max(1, std::stoi(value));
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Warning: Skipping malformed tuning profile line: " << line << "\n";
+            continue;
+        }
+        set(line.substr(0, tab1), line.substr(tab1 + 1, tab2 - tab1 - 1), params);
+    }
+    return true;
+}
+
+bool TuningProfile::save(const std::string& filename) const {
+    std::ofstream file(filename);
+    if (!file) {
+        std::cerr << "Error: Unable to open file for writing: " << filename << "\n";
+        return false;
+    }
+    file << "# GEMM tuning profile: <cpu model> TAB <shape class> TAB parameters\n";
+    for (const auto& entry : entries) {
+        const TuningParams& p = entry.second;
+        file << entry.first << "\t"
+             << "kernel=" << p.kernel << " mc=" << p.mc << " kc=" << p.kc << " nc=" << p.nc
+             << " block=" << p.block_size << " order=" << (p.loop_order == BlockLoopOrder::IKJ ? "ikj" : "ijk")
+             << " threads=" << p.threads << " cutoff=" << p.strassen_cutoff << "\n";
+    }
+    return true;
+}
+
+TuningProfile& tuning_profile() {
+    static TuningProfile profile = [] {
+        TuningProfile loaded;
+        loaded.load(tuning_profile_path());
+        return loaded;
+    }();
+    return profile;
+}
+
+TuningParams tuned_params(int m, int n, int k) {
+    static const std::string cpu = cpu_model_name();
+    const TuningParams* tuned = tuning_profile().find(cpu, shape_class(m, n, k));
+    if (tuned != nullptr) {
+        return *tuned;
+    }
+    TuningParams defaults;
+    defaults.kernel = select_gemm_kernel().name;
+    return defaults;
+}
+
+// One multiply kernel the benchmark suite can run; threaded kernels are swept over the thread counts
+struct BenchKernel {
+    const char* name;
+    bool threaded;
+    std::function<Matrix(const Matrix&, const Matrix&, int)> run;
+    // Reduced-precision kernels: the operand as the kernel sees it (right = B), so that verification checks
+    // the arithmetic against the rounded inputs and the rounding error is reported separately
+    std::function<Matrix(const Matrix&, bool right)> round_input = nullptr;
+};
+
+// Settings of the benchmark suite, filled from a config file and then from command-line flags
+struct BenchConfig {
+    std::vector<int> sizes = {256, 512, 1024, 1031};   // 1031: odd, so the kernels' edge handling is covered
+    std::vector<std::pair<float, float>> sparsities = {{0.0f, 0.0f}, {0.97f, 0.97f}};
+    std::vector<std::string> kernels = {"simd", "cache", "multithreaded", "optimized", "strassen", "sparse"};
+    std::vector<int> threads = {1, static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))};
+    int warmup = 1;
+    int repetitions = 5;
+    double tolerance = 1e-4;
+    int verify_rows = 16;
+    unsigned seed = 42;
+    bool pin_threads = false;
+    bool perf_counters = false;
+    bool autotune = false;
+    std::string profile_path;
+    std::string csv_path;
+    std::string json_path;
+};
+
+// Timing and verification results of one (size, sparsity, kernel, threads) point
+struct BenchResult {
+    int size;
+    float sparsity_A;
+    float sparsity_B;
+    std::string kernel;
+    int threads;
+    double median_s;
+    double p95_s;
+    double gflops;
+    double gbps;
+    double max_rel_error;
+    bool passed;
+    std::vector<PerfSample> perf_per_thread;   // Per repetition, empty unless --perf is set
+};
+
+static const std::vector<BenchKernel>& bench_kernels() {
+    static const std::vector<BenchKernel> kernels = {
+        {"native", false, [](const Matrix& A, const Matrix& B, int) { return multiply_native(A, B); }},
+        {"simd", false, [](const Matrix& A, const Matrix& B, int) { return multiply_simd(A, B); }},
+        {"cache", false, [](const Matrix& A, const Matrix& B, int) { return multiply_cache_optimized(A, B); }},
+        {"multithreaded", true, [](const Matrix& A, const Matrix& B, int t) { return multiply_multithreaded(A, B, t); }},
+        {"optimized", true, [](const Matrix& A, const Matrix& B, int t) { return multiply_optimized(A, B, t, true, true); }},
+        {"strassen", true, [](const Matrix& A, const Matrix& B, int t) { return multiply_strassen(A, B, t); }},
+        {"sparse", true, [](const Matrix& A, const Matrix& B, int t) {
+            shared_thread_pool(t);
+            return multiply_sparse_auto(A, B);
+        }},
+        // Reduced precision, timed including the conversion of both operands
+        {"bf16", true, [](const Matrix& A, const Matrix& B, int t) {
+            shared_thread_pool(t);
+            return multiply_bf16(to_bf16(A), to_bf16(B));
+        }, [](const Matrix& M, bool) { return to_fp32(to_bf16(M)); }},
+        {"fp16", true, [](const Matrix& A, const Matrix& B, int t) {
+            shared_thread_pool(t);
+            return multiply_fp16(to_fp16(A), to_fp16(B));
+        }, [](const Matrix& M, bool) { return to_fp32(to_fp16(M)); }},
+        {"int8", true, [](const Matrix& A, const Matrix& B, int t) {
+            shared_thread_pool(t);
+            return multiply_int8(quantize_int8(A, false), quantize_int8(B, true));
+        }, [](const Matrix& M, bool right) { return dequantize_int8(quantize_int8(M, right)); }},
+    };
+    return kernels;
+}
+
+template <typename T>
+static std::vector<T> parse_list(const std::string& text, T (*convert)(const std::string&)) {
+    std::vector<T> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            values.push_back(convert(item));
+        }
+    }
+    return values;
+}
+
+static int to_int(const std::string& text) { return std::stoi(text); }
+static std::string to_string_value(const std::string& text) { return text; }
+
+// "0.9" applies to both operands, "0:0.99" sets A and B separately
+static std::pair<float, float> to_sparsity(const std::string& text) {
+    size_t colon = text.find(':');
+    if (colon == std::string::npos) {
+        float value = std::stof(text);
+        return {value, value};
+    }
+    return {std::stof(text.substr(0, colon)), std::stof(text.substr(colon + 1))};
+}
+
+// Apply one key/value setting; used for both "--key value" flags and "key = value" config lines
+static bool apply_bench_setting(BenchConfig& config, const std::string& key, const std::string& value) {
+    if (key == "sizes") config.sizes = parse_list<int>(value, to_int);
+    else if (key == "sparsity") config.sparsities = parse_list<std::pair<float, float>>(value, to_sparsity);
+    else if (key == "kernels") config.kernels = parse_list<std::string>(value, to_string_value);
+    else if (key == "threads") config.threads = parse_list<int>(value, to_int);
+    else if (key == "warmup") config.warmup = std::stoi(value);
+    else if (key == "reps") config.repetitions = std::max(1, std::stoi(value));
+    else if (key == "tolerance") config.tolerance = std::stod(value);
+    else if (key == "verify-rows") config.verify_rows = std::stoi(value);
+    else if (key == "seed") config.seed = static_cast<unsigned>(std::stoul(value));
+    else if (key == "pin") config.pin_threads = (value == "1" || value == "true" || value == "yes");
+    else if (key == "perf") config.perf_counters = (value == "1" || value == "true" || value == "yes");
+    else if (key == "autotune") config.autotune = (value == "1" || value == "true" || value == "yes");
+    else if (key == "profile") config.profile_path = value;
+    else if (key == "csv") config.csv_path = value;
+    else if (key == "json") config.json_path = value;
+    else return false;
+    return true;
+}
+
+static bool load_bench_config(BenchConfig& config, const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file) {
+        std::cerr << "Error: Unable to open config file: " << filename << "\n";
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            continue;
+        }
+        auto trim = [](std::string text) {
+            text.erase(0, text.find_first_not_of(" \t\r"));
+            text.erase(text.find_last_not_of(" \t\r") + 1);
+            return text;
+        };
+        std::string key = trim(line.substr(0, eq));
+        if (!apply_bench_setting(config, key, trim(line.substr(eq + 1)))) {
+            std::cerr << "Error: Unknown config key: " << key << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+static void print_bench_usage(const char* program) {
+    std::cout << "Usage: " << program << " [--config file] [--sizes 512,1024] [--sparsity 0,0.9,0:0.99]\n"
+              << "       [--kernels native,simd,cache,multithreaded,optimized,strassen,sparse,bf16,fp16,int8] [--threads 1,4,8]\n"
+              << "       [--warmup 1] [--reps 5] [--tolerance 1e-4] [--verify-rows 16] [--seed 42]\n"
+              << "       [--pin 0|1] [--perf 0|1] [--csv results.csv] [--json results.json]\n"
+              << "       [--autotune 1 [--profile gemm_tuning.profile]]   (tunes each size in --sizes)\n"
+              << "Run without arguments for the interactive menu.\n";
+}
+
+// Compare sampled rows of C against a double-precision reference.
+// The error of each entry is scaled by sum_k |A(i, k) * B(k, j)|, the natural bound for float rounding.
+// Strassen-Winograd only has a normwise bound, so with `normwise` every error is scaled by
+// max|A| * max|B| * k instead: an entry whose exact value is 0 may then keep a rounding leftover.
+static double verify_sampled_rows(const Matrix& A, const Matrix& B, const Matrix& C, int sample_rows, unsigned seed,
+                                  bool normwise = false) {
+    double norm_scale = 0.0;
+    if (normwise) {
+        double max_A = 0.0, max_B = 0.0;
+        for (int i = 0; i < A.rows(); ++i) {
+            for (int k = 0; k < A.cols(); ++k) {
+                max_A = std::max(max_A, static_cast<double>(std::fabs(A(i, k))));
+            }
+        }
+        for (int k = 0; k < B.rows(); ++k) {
+            for (int j = 0; j < B.cols(); ++j) {
+                max_B = std::max(max_B, static_cast<double>(std::fabs(B(k, j))));
+            }
+        }
+        norm_scale = max_A * max_B * A.cols();
+    }
+
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> row_dis(0, std::max(A.rows() - 1, 0));
+    int samples = std::min(sample_rows, A.rows());
+    std::vector<double> reference(B.cols());
+    std::vector<double> magnitude(B.cols());
+    double max_error = 0.0;
+
+    for (int s = 0; s < samples; ++s) {
+        int i = (samples == A.rows()) ? s : row_dis(gen);
+        std::fill(reference.begin(), reference.end(), 0.0);
+        std::fill(magnitude.begin(), magnitude.end(), 0.0);
+        for (int k = 0; k < A.cols(); ++k) {
+            double a = A(i, k);
+            const float* b_row = B.row(k);
+            for (int j = 0; j < B.cols(); ++j) {
+                reference[j] += a * b_row[j];
+                magnitude[j] += std::fabs(a * b_row[j]);
+            }
+        }
+        for (int j = 0; j < B.cols(); ++j) {
+            double scale = normwise ? norm_scale : magnitude[j];
+            double error = std::fabs(C(i, j) - reference[j]) / std::max(scale, 1e-30);
+            max_error = std::max(max_error, error);
+        }
+    }
+    return max_error;
+}
+
+// Nearest-rank percentile of an already sorted sample
+static double percentile(const std::vector<double>& sorted, double fraction) {
+    size_t rank = static_cast<size_t>(std::ceil(fraction * sorted.size()));
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+static void write_bench_csv(const std::vector<BenchResult>& results, const std::string& filename) {
+    std::ofstream file(filename);
+    if (!file) {
+        std::cerr << "Error: Unable to open file for writing: " << filename << "\n";
+        return;
+    }
+    file << "size,sparsity_a,sparsity_b,kernel,threads,median_s,p95_s,gflops,gbps,max_rel_error,passed";
+    for (const char* name : PERF_EVENT_NAMES) {
+        file << "," << name;
+    }
+    file << "\n";
+    for (const auto& r : results) {
+        file << r.size << "," << r.sparsity_A << "," << r.sparsity_B << "," << r.kernel << "," << r.threads << ","
+             << r.median_s << "," << r.p95_s << "," << r.gflops << "," << r.gbps << "," << r.max_rel_error << ","
+             << (r.passed ? "true" : "false");
+        // Counter totals over all threads; left empty when counters were not collected
+        PerfSample total;
+        for (const auto& sample : r.perf_per_thread) {
+            total += sample;
+        }
+        for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+            file << ",";
+            if (!r.perf_per_thread.empty() && ThreadPerfCounters::current().available(static_cast<PerfEventId>(e))) {
+                file << total.values[e];
+            }
+        }
+        file << "\n";
+    }
+}
+
+static void write_bench_json(const std::vector<BenchResult>& results, const BenchConfig& config, const std::string& filename) {
+    std::ofstream file(filename);
+    if (!file) {
+        std::cerr << "Error: Unable to open file for writing: " << filename << "\n";
+        return;
+    }
+    file << "{\n"
+         << "  \"compiler\": \"" << __VERSION__ << "\",\n"
+         << "  \"gemm_kernel\": \"" << select_gemm_kernel().name << "\",\n"
+         << "  \"timestamp\": " << std::time(nullptr) << ",\n"
+         << "  \"warmup\": " << config.warmup << ",\n"
+         << "  \"repetitions\": " << config.repetitions << ",\n"
+         << "  \"tolerance\": " << config.tolerance << ",\n"
+         << "  \"results\": [\n";
+    for (size_t n = 0; n < results.size(); ++n) {
+        const auto& r = results[n];
+        file << "    {\"size\": " << r.size << ", \"sparsity_a\": " << r.sparsity_A << ", \"sparsity_b\": " << r.sparsity_B
+             << ", \"kernel\": \"" << r.kernel << "\", \"threads\": " << r.threads << ", \"median_s\": " << r.median_s
+             << ", \"p95_s\": " << r.p95_s << ", \"gflops\": " << r.gflops << ", \"gbps\": " << r.gbps
+             << ", \"max_rel_error\": " << r.max_rel_error << ", \"passed\": " << (r.passed ? "true" : "false");
+        if (!r.perf_per_thread.empty()) {
+            file << ", \"perf_per_thread\": [";
+            for (size_t t = 0; t < r.perf_per_thread.size(); ++t) {
+                file << (t > 0 ? ", " : "") << "{";
+                bool first = true;
+                for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+                    if (ThreadPerfCounters::current().available(static_cast<PerfEventId>(e))) {
+                        file << (first ? "" : ", ") << "\"" << PERF_EVENT_NAMES[e] << "\": " << r.perf_per_thread[t].values[e];
+                        first = false;
+                    }
+                }
+                file << "}";
+            }
+            file << "]";
+        }
+        file << "}"
+             << (n + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+}
+
+// Per-thread counters of one benchmark point, with miss rates per thousand instructions
+static void print_perf_sample(const std::vector<PerfSample>& per_thread) {
+    const ThreadPerfCounters& counters = ThreadPerfCounters::current();
+    for (size_t t = 0; t < per_thread.size(); ++t) {
+        const PerfSample& sample = per_thread[t];
+        std::cout << "    thread " << t << ":";
+        for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+            std::cout << " " << PERF_EVENT_NAMES[e] << "=";
+            if (counters.available(static_cast<PerfEventId>(e))) {
+                std::cout << sample.values[e];
+            } else {
+                std::cout << "n/a";
+            }
+        }
+        double instructions = sample.values[PERF_INSTRUCTIONS];
+        if (counters.available(PERF_INSTRUCTIONS) && instructions > 0) {
+            if (counters.available(PERF_CYCLES) && sample.values[PERF_CYCLES] > 0) {
+                std::cout << " ipc=" << instructions / sample.values[PERF_CYCLES];
+            }
+            if (counters.available(PERF_L1D_MISSES)) {
+                std::cout << " l1d_mpki=" << 1000.0 * sample.values[PERF_L1D_MISSES] / instructions;
+            }
+            if (counters.available(PERF_LLC_MISSES)) {
+                std::cout << " llc_mpki=" << 1000.0 * sample.values[PERF_LLC_MISSES] / instructions;
+            }
+        }
+        std::cout << std::endl;
+    }
+}
+
+// Median time of `reps` calls after one warmup call
+static double median_time(const std::function<void()>& fn, int reps) {
+    fn();
+    std::vector<double> times;
+    for (int r = 0; r < reps; ++r) {
+        auto start = std::chrono::high_resolution_clock::now();
+        fn();
+        auto end = std::chrono::high_resolution_clock::now();
+        times.push_back(std::chrono::duration<double>(end - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return percentile(times, 0.5);
+}
+
+// Search microkernel, MC/KC/NC, the blocked kernels' block size and loop order, and the thread count
+// for every size in config.sizes, then merge the winners into the profile file for this CPU.
+static int run_autotune(const BenchConfig& config) {
+    const std::string cpu = cpu_model_name();
+    const std::string path = config.profile_path.empty() ? tuning_profile_path() : config.profile_path;
+    const int reps = std::min(std::max(config.repetitions, 1), 3);
+
+    TuningProfile profile;
+    profile.load(path);
+    std::cout << "Autotuning for: " << cpu << std::endl;
+
+    for (int size : config.sizes) {
+        Matrix A = generate_matrix(size, size, 0.0f, config.seed);
+        Matrix B = generate_matrix(size, size, 0.0f, config.seed + 1);
+        std::string shape = shape_class(size, size, size);
+
+        // 1: Packed engine, single-threaded, coordinate descent over KC, then MC, then NC per microkernel
+        TuningParams best;
+        double best_time = 1e300;
+        for (const GemmKernel& kernel : available_gemm_kernels()) {
+            TuningParams params;
+            params.kernel = kernel.name;
+            params.mc = kernel.mc;
+            params.kc = kernel.kc;
+            params.nc = kernel.nc;
+            double params_time = median_time([&] { multiply_optimized_with_params(A, B, 1, true, true, params); }, reps);
+
+            auto try_values = [&](int TuningParams::*field, const std::vector<int>& values) {
+                for (int value : values) {
+                    TuningParams candidate = params;
+                    candidate.*field = value;
+                    double t = median_time([&] { multiply_optimized_with_params(A, B, 1, true, true, candidate); }, reps);
+                    if (t < params_time) {
+                        params_time = t;
+                        params = candidate;
+                    }
+                }
+            };
+            try_values(&TuningParams::kc, {128, 192, 256, 320, 384, 512});
+            try_values(&TuningParams::mc, {4 * kernel.mr, 8 * kernel.mr, 16 * kernel.mr, 24 * kernel.mr, 40 * kernel.mr});
+            try_values(&TuningParams::nc, {32 * kernel.nr, 64 * kernel.nr, 128 * kernel.nr, 256 * kernel.nr});
+
+            std::cout << size << ": " << kernel.name << " mc=" << params.mc << " kc=" << params.kc << " nc=" << params.nc
+                      << " -> " << params_time << " s" << std::endl;
+            if (params_time < best_time) {
+                best_time = params_time;
+                best = params;
+            }
+        }
+
+        // 2: Cache-blocked scalar kernel: block size x loop order
+        double blocked_time = 1e300;
+        for (int block : {16, 32, 64, 128, 256}) {
+            for (BlockLoopOrder order : {BlockLoopOrder::IJK, BlockLoopOrder::IKJ}) {
+                TuningParams candidate = best;
+                candidate.block_size = block;
+                candidate.loop_order = order;
+                double t = median_time([&] { multiply_cache_optimized_with_params(A, B, candidate); }, reps);
+                if (t < blocked_time) {
+                    blocked_time = t;
+                    best.block_size = block;
+                    best.loop_order = order;
+                }
+            }
+        }
+        std::cout << size << ": blocked block=" << best.block_size
+                  << " order=" << (best.loop_order == BlockLoopOrder::IKJ ? "ikj" : "ijk") << " -> " << blocked_time << " s" << std::endl;
+
+        // 3: Thread count for the tuned packed engine
+        double threads_time = 1e300;
+        for (int threads : config.threads) {
+            double t = median_time([&] { multiply_optimized_with_params(A, B, threads, true, true, best); }, reps);
+            if (t < threads_time) {
+                threads_time = t;
+                best.threads = threads;
+            }
+        }
+        std::cout << size << ": threads=" << best.threads << " -> " << threads_time << " s ("
+                  << 2.0 * size * size * size / threads_time / 1e9 << " GFLOP/s)" << std::endl;
+
+        // 4: Strassen-Winograd cutoff. The baseline is no recursion at all, which is the tuned packed engine of
+        // step 3, so a cutoff is only kept if it beats that. Otherwise the cutoff covers the whole shape class
+        // (its largest dimension, a power of two as in shape_class), and multiply_strassen never recurses.
+        int no_recursion = 64;
+        while (no_recursion < size) {
+            no_recursion *= 2;
+        }
+        best.strassen_cutoff = no_recursion;
+        double cutoff_time = threads_time;
+        for (int cutoff : {128, 256, 512, 1024, 2048}) {
+            if (cutoff >= size) {
+                break;
+            }
+            double t = median_time([&] { multiply_strassen(A, B, best.threads, cutoff); }, reps);
+            if (t < cutoff_time) {
+                cutoff_time = t;
+                best.strassen_cutoff = cutoff;
+            }
+        }
+        std::cout << size << ": strassen cutoff=" << best.strassen_cutoff << " -> " << cutoff_time << " s"
+                  << (best.strassen_cutoff == no_recursion ? " (no recursion: classical is faster)" : "") << std::endl;
+
+        profile.set(cpu, shape, best);
+        tuning_profile().set(cpu, shape, best);
+    }
+
+    if (!profile.save(path)) {
+        return 1;
+    }
+    std::cout << "Saved tuning profile to " << path << std::endl;
+    return 0;
+}
+
+int run_benchmark_suite(int argc, char** argv) {
+    BenchConfig config;
+    for (int a = 1; a < argc; ++a) {
+        std::string flag = argv[a];
+        if (flag == "--help" || flag == "-h") {
+            print_bench_usage(argv[0]);
+            return 0;
+        }
+        if (flag.compare(0, 2, "--") != 0 || a + 1 >= argc) {
+            std::cerr << "Error: Expected --flag value, got: " << flag << "\n";
+            print_bench_usage(argv[0]);
+            return 2;
+        }
+        std::string key = flag.substr(2);
+        std::string value = argv[++a];
+        try {
+            if (key == "config") {
+                if (!load_bench_config(config, value)) {
+                    return 2;
+                }
+            } else if (!apply_bench_setting(config, key, value)) {
+                std::cerr << "Error: Unknown flag: " << flag << "\n";
+                print_bench_usage(argv[0]);
+                return 2;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Error: Invalid value for " << flag << ": " << value << "\n";
+            return 2;
+        }
+    }
+
+    std::vector<const BenchKernel*> selected;
+    for (const auto& name : config.kernels) {
+        auto it = std::find_if(bench_kernels().begin(), bench_kernels().end(), [&](const BenchKernel& k) { return name == k.name; });
+        if (it == bench_kernels().end()) {
+            std::cerr << "Error: Unknown kernel: " << name << "\n";
+            return 2;
+        }
+        selected.push_back(&*it);
+    }
+
+    // Set once for the whole run: kernels only request a thread count, so the pool keeps this setting
+    set_thread_pinning(config.pin_threads);
+
+    if (config.autotune) {
+        return run_autotune(config);
+    }
+
+    if (config.perf_counters && !ThreadPerfCounters::current().any_available()) {
+        std::cerr << "Warning: hardware performance counters are unavailable (no PMU or perf_event_paranoid too high); "
+                  << "continuing without them.\n";
+        config.perf_counters = false;
+    }
+
+    std::vector<BenchResult> results;
+    bool all_passed = true;
+    std::cout << "size\tsp_A\tsp_B\tkernel\t\tthreads\tmedian_s\tp95_s\t\tGFLOP/s\tGB/s\tmax_err\tstatus" << std::endl;
+
+    for (int size : config.sizes) {
+        for (const auto& sparsity : config.sparsities) {
+            Matrix A = generate_matrix(size, size, sparsity.first, config.seed);
+            Matrix B = generate_matrix(size, size, sparsity.second, config.seed + 1);
+
+            for (const BenchKernel* kernel : selected) {
+                std::vector<int> thread_counts = kernel->threaded ? config.threads : std::vector<int>{1};
+                for (int threads : thread_counts) {
+                    shared_thread_pool(threads);
+
+                    for (int w = 0; w < config.warmup; ++w) {
+                        kernel->run(A, B, threads);
+                    }
+
+                    std::vector<double> times;
+                    Matrix C;
+                    PerfKernelStats perf_stats;
+                    perf_stats.kernel = kernel->name;
+                    for (int r = 0; r < config.repetitions; ++r) {
+                        auto start = std::chrono::high_resolution_clock::now();
+                        {
+                            PerfScope scope(config.perf_counters ? &perf_stats : nullptr);
+                            C = kernel->run(A, B, threads);
+                        }
+                        auto end = std::chrono::high_resolution_clock::now();
+                        times.push_back(std::chrono::duration<double>(end - start).count());
+                    }
+                    std::sort(times.begin(), times.end());
+
+                    BenchResult result;
+                    result.size = size;
+                    result.sparsity_A = sparsity.first;
+                    result.sparsity_B = sparsity.second;
+                    result.kernel = kernel->name;
+                    result.threads = threads;
+                    result.median_s = percentile(times, 0.5);
+                    result.p95_s = percentile(times, 0.95);
+                    // Nominal dense work and compulsory traffic (read A and B, write C once)
+                    double n = size;
+                    result.gflops = 2.0 * n * n * n / result.median_s / 1e9;
+                    result.gbps = 3.0 * n * n * sizeof(float) / result.median_s / 1e9;
+                    if (kernel->round_input) {
+                        result.max_rel_error = verify_sampled_rows(kernel->round_input(A, false), kernel->round_input(B, true),
+                                                                   C, config.verify_rows, config.seed);
+                    } else {
+                        result.max_rel_error = verify_sampled_rows(A, B, C, config.verify_rows, config.seed,
+                                                                   result.kernel == "strassen");
+                    }
+                    result.passed = result.max_rel_error <= config.tolerance;
+                    all_passed = all_passed && result.passed;
+                    for (PerfSample sample : perf_stats.per_thread) {
+                        for (double& value : sample.values) {
+                            value /= config.repetitions;
+                        }
+                        result.perf_per_thread.push_back(sample);
+                    }
+                    results.push_back(result);
+
+                    std::cout << result.size << "\t" << result.sparsity_A << "\t" << result.sparsity_B << "\t"
+                              << result.kernel << (result.kernel.size() < 8 ? "\t\t" : "\t") << result.threads << "\t"
+                              << result.median_s << "\t" << result.p95_s << "\t" << result.gflops << "\t"
+                              << result.gbps << "\t" << result.max_rel_error << "\t" << (result.passed ? "ok" : "FAIL") << std::endl;
+                    if (config.perf_counters) {
+                        print_perf_sample(result.perf_per_thread);
+                    }
+                    if (kernel->round_input) {
+                        std::cout << "    Input rounding error against fp32 (same scale as max_err): "
+                                  << verify_sampled_rows(A, B, C, config.verify_rows, config.seed) << std::endl;
+                    }
+                    if (result.kernel == "strassen") {
+                        Matrix classical = multiply_optimized(A, B, threads, true, true);
+                        print_strassen_error_report(strassen_error_report(A, B, C, classical,
+                            tuned_params(size, size, size).strassen_cutoff, config.verify_rows));
+                    }
+                }
+            }
+        }
+    }
+
+    if (!config.csv_path.empty()) {
+        write_bench_csv(results, config.csv_path);
+    }
+    if (!config.json_path.empty()) {
+        write_bench_json(results, config, config.json_path);
+    }
+    return all_passed ? 0 : 1;
+}
+
+
+// Z = X + sign * Y; Z may alias X or Y
+static void matrix_add(ConstMatrixView X, ConstMatrixView Y, MatrixView Z, float sign) {
+    __m256 sign_vec = _mm256_set1_ps(sign);
+    for (int i = 0; i < Z.rows; ++i) {
+        const float* x = X.row(i);
+        const float* y = Y.row(i);
+        float* z = Z.row(i);
+        int j = 0;
+        for (; j + 8 <= Z.cols; j += 8) {
+            _mm256_storeu_ps(z + j, _mm256_fmadd_ps(sign_vec, _mm256_loadu_ps(y + j), _mm256_loadu_ps(x + j)));
+        }
+        for (; j < Z.cols; ++j) {
+            z[j] = x[j] + sign * y[j];
+        }
+    }
+}
+
+static void matrix_zero(MatrixView Z) {
+    for (int i = 0; i < Z.rows; ++i) {
+        std::memset(Z.row(i), 0, Z.cols * sizeof(float));
+    }
+}
+
+static bool strassen_is_base_case(int m, int n, int k, int cutoff) {
+    return std::min({m, n, k}) <= std::max(cutoff, 1);
+}
+
+// Levels of recursion multiply_strassen performs for this shape
+static int strassen_depth(int m, int n, int k, int cutoff) {
+    int depth = 0;
+    while (!strassen_is_base_case(m, n, k, cutoff)) {
+        m /= 2;
+        n /= 2;
+        k /= 2;
+        ++depth;
+    }
+    return depth;
+}
+
+// Floats of scratch the recursion needs: X (m/2 x max(k/2, n/2)) and Y (k/2 x n/2) per level
+static size_t strassen_scratch_floats(int m, int n, int k, int cutoff) {
+    size_t total = 0;
+    while (!strassen_is_base_case(m, n, k, cutoff)) {
+        m /= 2;
+        n /= 2;
+        k /= 2;
+        total += static_cast<size_t>(m) * ScratchArena::padded_ld(std::max(k, n));
+        total += static_cast<size_t>(k) * ScratchArena::padded_ld(n);
+    }
+    return total;
+}
+
+// C = A * B. Winograd's 7-multiplication, 15-addition schedule with two temporaries per level
+// (Boyer, Dumas, Pernet and Zhou, "Memory efficient scheduling of Strassen-Winograd's matrix multiplication").
+static void strassen_recursive(ConstMatrixView A, ConstMatrixView B, MatrixView C, int cutoff, ScratchArena& arena,
+                               const GemmKernel& kernel, ThreadPool& pool) {
+    const int m = A.rows;
+    const int k = A.cols;
+    const int n = B.cols;
+
+    if (strassen_is_base_case(m, n, k, cutoff)) {
+        matrix_zero(C);
+        gemm_packed_parallel(A, B, C, kernel, pool);
+        return;
+    }
+
+    const int m2 = m / 2;
+    const int k2 = k / 2;
+    const int n2 = n / 2;
+
+    ConstMatrixView A11 = A.block(0, 0, m2, k2), A12 = A.block(0, k2, m2, k2);
+    ConstMatrixView A21 = A.block(m2, 0, m2, k2), A22 = A.block(m2, k2, m2, k2);
+    ConstMatrixView B11 = B.block(0, 0, k2, n2), B12 = B.block(0, n2, k2, n2);
+    ConstMatrixView B21 = B.block(k2, 0, k2, n2), B22 = B.block(k2, n2, k2, n2);
+    MatrixView C11 = C.block(0, 0, m2, n2), C12 = C.block(0, n2, m2, n2);
+    MatrixView C21 = C.block(m2, 0, m2, n2), C22 = C.block(m2, n2, m2, n2);
+
+    size_t mark = arena.mark();
+    MatrixView X = arena.take(m2, std::max(k2, n2));
+    MatrixView Y = arena.take(k2, n2);
+    MatrixView XA = X.block(0, 0, m2, k2);   // X holding an m2 x k2 sum of A blocks
+    MatrixView XC = X.block(0, 0, m2, n2);   // X holding the product P1
+
+    auto recurse = [&](ConstMatrixView left, ConstMatrixView right, MatrixView out) {
+        strassen_recursive(left, right, out, cutoff, arena, kernel, pool);
+    };
+
+    matrix_add(A11, A21, XA, -1.0f);   // S3 = A11 - A21
+    matrix_add(B22, B12, Y, -1.0f);    // T3 = B22 - B12
+    recurse(XA, Y, C21);               // P7 = S3 T3
+    matrix_add(A21, A22, XA, 1.0f);    // S1 = A21 + A22
+    matrix_add(B12, B11, Y, -1.0f);    // T1 = B12 - B11
+    recurse(XA, Y, C22);               // P5 = S1 T1
+    matrix_add(XA, A11, XA, -1.0f);    // S2 = S1 - A11
+    matrix_add(B22, Y, Y, -1.0f);      // T2 = B22 - T1
+    recurse(XA, Y, C12);               // P6 = S2 T2
+    matrix_add(A12, XA, XA, -1.0f);    // S4 = A12 - S2
+    recurse(XA, B22, C11);             // P3 = S4 B22
+    recurse(A11, B11, XC);             // P1 = A11 B11
+    matrix_add(XC, C12, C12, 1.0f);    // U2 = P1 + P6
+    matrix_add(C12, C21, C21, 1.0f);   // U3 = U2 + P7
+    matrix_add(C12, C22, C12, 1.0f);   // U4 = U2 + P5
+    matrix_add(C21, C22, C22, 1.0f);   // U7 = U3 + P5   -> C22
+    matrix_add(C12, C11, C12, 1.0f);   // U5 = U4 + P3   -> C12
+    matrix_add(Y, B21, Y, -1.0f);      // T4 = T2 - B21
+    recurse(A22, Y, C11);              // P4 = A22 T4
+    matrix_add(C21, C11, C21, -1.0f);  // U6 = U3 - P4   -> C21
+    recurse(A12, B21, C11);            // P2 = A12 B21
+    matrix_add(XC, C11, C11, 1.0f);    // U1 = P1 + P2   -> C11
+
+    arena.release(mark);
+
+    // Dynamic peeling: fix up the odd row / column / shared index left out of the even core
+    if (k % 2 != 0) {
+        gemm_packed_parallel(A.block(0, k - 1, 2 * m2, 1), B.block(k - 1, 0, 1, 2 * n2), C.block(0, 0, 2 * m2, 2 * n2), kernel, pool);
+    }
+    if (n % 2 != 0) {
+        MatrixView last_col = C.block(0, n - 1, m, 1);
+        matrix_zero(last_col);
+        gemm_packed_parallel(A, B.block(0, n - 1, k, 1), last_col, kernel, pool);
+    }
+    if (m % 2 != 0) {
+        MatrixView last_row = C.block(m - 1, 0, 1, 2 * n2);
+        matrix_zero(last_row);
+        gemm_packed_parallel(A.block(m - 1, 0, 1, k), B.block(0, 0, k, 2 * n2), last_row, kernel, pool);
+    }
+}
+
+Matrix multiply_strassen(const Matrix& A, const Matrix& B, int num_threads, int cutoff) {
+    TuningParams params = tuned_params(A.rows(), B.cols(), A.cols());
+    if (cutoff <= 0) {
+        cutoff = params.strassen_cutoff;
+    }
+    if (num_threads <= 0) {
+        num_threads = params.threads;
+    }
+
+    Matrix result(A.rows(), B.cols());
+    ScratchArena arena(strassen_scratch_floats(A.rows(), B.cols(), A.cols(), cutoff));
+    strassen_recursive(A.view(), B.view(), result.view(), cutoff, arena, tuned_gemm_kernel(params), shared_thread_pool(num_threads));
+    return result;
+}
+
+StrassenErrorReport strassen_error_report(const Matrix& A, const Matrix& B, const Matrix& C_strassen, const Matrix& C_classical,
+                                          int cutoff, int sample_rows) {
+    StrassenErrorReport report;
+    const int m = A.rows();
+    const int k = A.cols();
+    const int n = B.cols();
+
+    double max_A = 0.0, max_B = 0.0;
+    for (int i = 0; i < m; ++i) {
+        for (int p = 0; p < k; ++p) {
+            max_A = std::max(max_A, static_cast<double>(std::fabs(A(i, p))));
+        }
+    }
+    for (int p = 0; p < k; ++p) {
+        for (int j = 0; j < n; ++j) {
+            max_B = std::max(max_B, static_cast<double>(std::fabs(B(p, j))));
+        }
+    }
+    double scale = std::max(max_A * max_B, 1e-300);
+
+    // Exact (double-precision) rows, evenly spaced so the sample covers every quadrant of the recursion
+    int samples = std::max(1, std::min(sample_rows, m));
+    std::vector<double> reference(n);
+    report.strassen_error = 0.0;
+    report.classical_error = 0.0;
+    for (int s = 0; s < samples && m > 0; ++s) {
+        int i = static_cast<int>(static_cast<long long>(s) * m / samples);
+        std::fill(reference.begin(), reference.end(), 0.0);
+        for (int p = 0; p < k; ++p) {
+            double a = A(i, p);
+            const float* b_row = B.row(p);
+            for (int j = 0; j < n; ++j) {
+                reference[j] += a * b_row[j];
+            }
+        }
+        for (int j = 0; j < n; ++j) {
+            report.strassen_error = std::max(report.strassen_error, std::fabs(C_strassen(i, j) - reference[j]) / scale);
+            report.classical_error = std::max(report.classical_error, std::fabs(C_classical(i, j) - reference[j]) / scale);
+        }
+    }
+
+    // Higham, "Accuracy and Stability of Numerical Algorithms", sec. 23.2.2, in the max-abs norm:
+    //   classical: n^2 u,   Winograd: ((n / n0)^log2(18) (n0^2 + 6 n0) - 6 n) u
+    const double u = std::ldexp(1.0, -24);
+    const double size = std::max({m, n, k});
+    report.depth = strassen_depth(m, n, k, cutoff);
+    const double n0 = size / std::ldexp(1.0, report.depth);
+    report.classical_bound = size * size * u;
+    report.strassen_bound = (std::pow(18.0, report.depth) * (n0 * n0 + 6.0 * n0) - 6.0 * size) * u;
+    return report;
+}
+
+void print_strassen_error_report(const StrassenErrorReport& report) {
+    std::cout << "    Error report (units of max|A| * max|B|), recursion depth " << report.depth << ":" << std::endl;
+    std::cout << "      Strassen-Winograd: measured " << report.strassen_error << ", bound " << report.strassen_bound << std::endl;
+    std::cout << "      Classical:         measured " << report.classical_error << ", bound " << report.classical_bound << std::endl;
+}
+
+
+// Rows of A per register tile in the reduced-precision kernels: 4 with 16-column AVX2 tiles (8 ymm accumulators),
+// 8 with 32-column AVX-512 tiles (16 zmm accumulators)
+constexpr int LOWP_ROWS_AVX2 = 4;
+constexpr int LOWP_ROWS_AVX512 = 8;
+
+// Reduced-precision instruction sets, checked once with CPUID
+struct LowPrecisionSupport {
+    bool f16c;
+    bool avx512_bf16;
+    bool avx512_vnni;
+};
+
+static const LowPrecisionSupport& low_precision_support() {
+    static const LowPrecisionSupport support = [] {
+        __builtin_cpu_init();
+        LowPrecisionSupport s;
+        s.f16c = __builtin_cpu_supports("f16c");
+        s.avx512_bf16 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bf16");
+        s.avx512_vnni = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vnni");
+        return s;
+    }();
+    return support;
+}
+
+static uint32_t float_bits(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static float bits_float(uint32_t bits) {
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// bf16 is the upper half of an fp32; round the dropped half to nearest even and keep NaNs quiet
+static uint16_t float_to_bfloat(float f) {
+    uint32_t bits = float_bits(f);
+    if ((bits & 0x7FFFFFFFu) > 0x7F800000u) {
+        return static_cast<uint16_t>((bits >> 16) | 0x40u);
+    }
+    bits += 0x7FFFu + ((bits >> 16) & 1u);
+    return static_cast<uint16_t>(bits >> 16);
+}
+
+static float bfloat_to_float(uint16_t b) {
+    return bits_float(static_cast<uint32_t>(b) << 16);
+}
+
+// fp32 <-> IEEE half without F16C, with round to nearest even. The fp32 add and multiply do the rounding
+// and the subnormal handling (the method of Marat Dukhan's FP16 library).
+static uint16_t float_to_half(float f) {
+    float base = (std::fabs(f) * 0x1.0p+112f) * 0x1.0p-110f;
+    const uint32_t w = float_bits(f);
+    const uint32_t shl1_w = w + w;
+    const uint32_t sign = w & 0x80000000u;
+    uint32_t bias = shl1_w & 0xFF000000u;
+    if (bias < 0x71000000u) {
+        bias = 0x71000000u;
+    }
+    base = bits_float((bias >> 1) + 0x07800000u) + base;
+    const uint32_t bits = float_bits(base);
+    const uint32_t nonsign = ((bits >> 13) & 0x7C00u) + (bits & 0x0FFFu);
+    return static_cast<uint16_t>((sign >> 16) | (shl1_w > 0xFF000000u ? 0x7E00u : nonsign));
+}
+
+static float half_to_float(uint16_t h) {
+    const uint32_t w = static_cast<uint32_t>(h) << 16;
+    const uint32_t sign = w & 0x80000000u;
+    const uint32_t two_w = w + w;
+    const float normalized = bits_float((two_w >> 4) + (0xE0u << 23)) * 0x1.0p-112f;
+    const float denormalized = bits_float((two_w >> 17) | (126u << 23)) - 0.5f;
+    return bits_float(sign | (two_w < (1u << 27) ? float_bits(denormalized) : float_bits(normalized)));
+}
+
+template <typename To, typename From, typename Convert>
+static BasicMatrix<To> convert_elements(const BasicMatrix<From>& M, Convert convert) {
+    BasicMatrix<To> result(M.rows(), M.cols());
+    for (int i = 0; i < M.rows(); ++i) {
+        const From* src = M.row(i);
+        To* dst = result.row(i);
+        for (int j = 0; j < M.cols(); ++j) {
+            dst[j] = convert(src[j]);
+        }
+    }
+    return result;
+}
+
+BasicMatrix<bfloat16> to_bf16(const Matrix& M) {
+    return convert_elements<bfloat16>(M, [](float x) { return bfloat16{float_to_bfloat(x)}; });
+}
+
+BasicMatrix<float16> to_fp16(const Matrix& M) {
+    return convert_elements<float16>(M, [](float x) { return float16{float_to_half(x)}; });
+}
+
+Matrix to_fp32(const BasicMatrix<bfloat16>& M) {
+    return convert_elements<float>(M, [](bfloat16 x) { return bfloat_to_float(x.bits); });
+}
+
+Matrix to_fp32(const BasicMatrix<float16>& M) {
+    return convert_elements<float>(M, [](float16 x) { return half_to_float(x.bits); });
+}
+
+// scale = max |line| / 127, so the largest entry maps to +-127; an all-zero line keeps scale 1
+QuantizedMatrix quantize_int8(const Matrix& M, bool per_column) {
+    QuantizedMatrix Q;
+    Q.values = BasicMatrix<int8_t>(M.rows(), M.cols());
+    Q.per_column = per_column;
+    Q.scales.assign(per_column ? M.cols() : M.rows(), 0.0f);
+    for (int i = 0; i < M.rows(); ++i) {
+        for (int j = 0; j < M.cols(); ++j) {
+            float& scale = Q.scales[per_column ? j : i];
+            scale = std::max(scale, std::fabs(M(i, j)));
+        }
+    }
+    for (float& scale : Q.scales) {
+        scale = scale > 0.0f ? scale / 127.0f : 1.0f;
+    }
+    for (int i = 0; i < M.rows(); ++i) {
+        for (int j = 0; j < M.cols(); ++j) {
+            long q = std::lrint(M(i, j) / Q.scales[per_column ? j : i]);
+            Q.values(i, j) = static_cast<int8_t>(std::max(-127L, std::min(127L, q)));
+        }
+    }
+    return Q;
+}
+
+Matrix dequantize_int8(const QuantizedMatrix& Q) {
+    Matrix result(Q.values.rows(), Q.values.cols());
+    for (int i = 0; i < result.rows(); ++i) {
+        for (int j = 0; j < result.cols(); ++j) {
+            result(i, j) = Q.values(i, j) * Q.scales[Q.per_column ? j : i];
+        }
+    }
+    return result;
+}
+
+// Pack `group` consecutive rows of B into one 32-bit word per column: word (p, j) holds B(group * p + g, j)
+// in bits [g * 32 / group, (g + 1) * 32 / group). Rows past the end of B and columns up to ldb are zero.
+template <typename T, typename Bits>
+static std::vector<uint32_t> interleave_rows(const BasicMatrix<T>& B, int group, int ldb, Bits bits) {
+    const int k = B.rows();
+    const int n = B.cols();
+    const int groups = (k + group - 1) / group;
+    const int width = 32 / group;
+    std::vector<uint32_t> packed(static_cast<size_t>(groups) * ldb, 0u);
+    shared_thread_pool(0).parallel_for(groups, [&](int p) {
+        uint32_t* dst = &packed[static_cast<size_t>(p) * ldb];
+        for (int g = 0; g < group && group * p + g < k; ++g) {
+            const T* b_row = B.row(group * p + g);
+            for (int j = 0; j < n; ++j) {
+                dst[j] |= static_cast<uint32_t>(bits(b_row[j])) << (g * width);
+            }
+        }
+    });
+    return packed;
+}
+
+// Shared tile loop of the reduced-precision kernels. For every ROWS-row strip of a pool tile,
+// prepare(i, rows) lays out that strip of A once; micro(a, i, j, tile) then computes a ROWS x COLS
+// fp32 tile at column j, of which the rows and columns inside C are copied out.
+template <int ROWS, int COLS, typename Prepare, typename Micro>
+static void lowp_for_tiles(Matrix& C, Prepare prepare, Micro micro) {
+    shared_thread_pool(0).parallel_for_tiles(C.rows(), C.cols(), TILE_ROWS, TILE_COLS, [&](int i_start, int i_end, int j_start, int j_end) {
+        alignas(MATRIX_ALIGNMENT) float tile[ROWS * COLS];
+        for (int i = i_start; i < i_end; i += ROWS) {
+            int rows = std::min(ROWS, i_end - i);
+            auto a = prepare(i, rows);
+            for (int j = j_start; j < j_end; j += COLS) {
+                micro(a, i, j, tile);
+                int cols = std::min(COLS, j_end - j);
+                for (int r = 0; r < rows; ++r) {
+                    std::memcpy(C.row(i + r) + j, tile + r * COLS, cols * sizeof(float));
+                }
+            }
+        }
+    });
+}
+
+// Eight 16-bit values widened to fp32
+__attribute__((target("f16c")))
+static inline __m256 load8_as_fp32(const float16* p) {
+    return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+static inline __m256 load8_as_fp32(const bfloat16* p) {
+    __m256i wide = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(wide, 16));
+}
+
+// Widen rows [i, i + rows) of A to fp32, LOWP_ROWS_AVX2 rows of k_pad floats (rows past `rows` are zero)
+template <typename T>
+__attribute__((target("f16c")))
+static const float* widen_rows(const BasicMatrix<T>& A, int i, int rows, int k_pad) {
+    float* a = gemm_workspace(2, static_cast<size_t>(LOWP_ROWS_AVX2) * k_pad);
+    for (int r = 0; r < LOWP_ROWS_AVX2; ++r) {
+        float* dst = a + static_cast<size_t>(r) * k_pad;
+        if (r >= rows) {
+            std::memset(dst, 0, k_pad * sizeof(float));
+            continue;
+        }
+        const T* src = A.row(i + r);
+        for (int p = 0; p < k_pad; p += 8) {
+            _mm256_store_ps(dst + p, load8_as_fp32(src + p));
+        }
+    }
+    return a;
+}
+
+// 4x16 register tile over B widened to fp32 on the fly (8 ymm accumulators):
+// tile[r][0:16] = sum_p a[r][p] * B(p, j:j+16), with `a` from widen_rows
+template <typename T>
+__attribute__((target("f16c")))
+static void lowp_micro_avx2_4x16(const float* a, int k_pad, const BasicMatrix<T>& B, int j, float* tile) {
+    __m256 acc[LOWP_ROWS_AVX2][2];
+#pragma GCC unroll 4
+    for (int r = 0; r < LOWP_ROWS_AVX2; ++r) {
+        acc[r][0] = _mm256_setzero_ps();
+        acc[r][1] = _mm256_setzero_ps();
+    }
+    for (int p = 0; p < B.rows(); ++p) {
+        const T* b = B.row(p) + j;
+        __m256 b0 = load8_as_fp32(b);
+        __m256 b1 = load8_as_fp32(b + 8);
+#pragma GCC unroll 4
+        for (int r = 0; r < LOWP_ROWS_AVX2; ++r) {
+            __m256 a_vec = _mm256_broadcast_ss(a + static_cast<size_t>(r) * k_pad + p);
+            acc[r][0] = _mm256_fmadd_ps(a_vec, b0, acc[r][0]);
+            acc[r][1] = _mm256_fmadd_ps(a_vec, b1, acc[r][1]);
+        }
+    }
+#pragma GCC unroll 4
+    for (int r = 0; r < LOWP_ROWS_AVX2; ++r) {
+        _mm256_store_ps(tile + r * 16, acc[r][0]);
+        _mm256_store_ps(tile + r * 16 + 8, acc[r][1]);
+    }
+}
+
+// 8x32 register tile with VDPBF16PS: each instruction multiplies a broadcast pair (A(i, 2p), A(i, 2p + 1))
+// with the same pair of rows in 16 columns of B and adds both products to fp32 lanes.
+// `a` holds LOWP_ROWS_AVX512 rows of k2 pairs, `b` is B interleaved in pairs of rows with leading dimension ldb.
+__attribute__((target("avx512f,avx512bf16")))
+static void bf16_micro_avx512_8x32(const uint32_t* a, int k2, const uint32_t* b, int ldb, float* tile) {
+    __m512 acc[LOWP_ROWS_AVX512][2];
+#pragma GCC unroll 8
+    for (int r = 0; r < LOWP_ROWS_AVX512; ++r) {
+        acc[r][0] = _mm512_setzero_ps();
+        acc[r][1] = _mm512_setzero_ps();
+    }
+    for (int p = 0; p < k2; ++p) {
+        const uint32_t* b_row = b + static_cast<size_t>(p) * ldb;
+        __m512bh b0 = (__m512bh)_mm512_loadu_si512(b_row);
+        __m512bh b1 = (__m512bh)_mm512_loadu_si512(b_row + 16);
+#pragma GCC unroll 8
+        for (int r = 0; r < LOWP_ROWS_AVX512; ++r) {
+            __m512bh a_pair = (__m512bh)_mm512_set1_epi32(static_cast<int>(a[static_cast<size_t>(r) * k2 + p]));
+            acc[r][0] = _mm512_dpbf16_ps(acc[r][0], a_pair, b0);
+            acc[r][1] = _mm512_dpbf16_ps(acc[r][1], a_pair, b1);
+        }
+    }
+#pragma GCC unroll 8
+    for (int r = 0; r < LOWP_ROWS_AVX512; ++r) {
+        _mm512_store_ps(tile + r * 32, acc[r][0]);
+        _mm512_store_ps(tile + r * 32 + 16, acc[r][1]);
+    }
+}
+
+// 8x32 register tile with VPDPBUSD: each instruction multiplies 4 consecutive k of A (unsigned, broadcast)
+// with the same 4 rows in 16 columns of B (signed) and adds the 4 products to int32 lanes.
+// A is stored offset by +128 to fit the unsigned operand; b_offset = 128 * column sums of B removes it
+// before the int32 sums are scaled back to fp32.
+__attribute__((target("avx512f,avx512vnni")))
+static void int8_micro_vnni_8x32(const uint32_t* a, int k4, const uint32_t* b, int ldb, const int32_t* b_offset,
+                                 const float* a_scales, const float* b_scales, float* tile) {
+    __m512i acc[LOWP_ROWS_AVX512][2];
+#pragma GCC unroll 8
+    for (int r = 0; r < LOWP_ROWS_AVX512; ++r) {
+        acc[r][0] = _mm512_setzero_si512();
+        acc[r][1] = _mm512_setzero_si512();
+    }
+    for (int p = 0; p < k4; ++p) {
+        const uint32_t* b_row = b + static_cast<size_t>(p) * ldb;
+        __m512i b0 = _mm512_loadu_si512(b_row);
+        __m512i b1 = _mm512_loadu_si512(b_row + 16);
+#pragma GCC unroll 8
+        for (int r = 0; r < LOWP_ROWS_AVX512; ++r) {
+            __m512i a_quad = _mm512_set1_epi32(static_cast<int>(a[static_cast<size_t>(r) * k4 + p]));
+            acc[r][0] = _mm512_dpbusd_epi32(acc[r][0], a_quad, b0);
+            acc[r][1] = _mm512_dpbusd_epi32(acc[r][1], a_quad, b1);
+        }
+    }
+#pragma GCC unroll 8
+    for (int r = 0; r < LOWP_ROWS_AVX512; ++r) {
+        __m512 a_scale = _mm512_set1_ps(a_scales[r]);
+        for (int h = 0; h < 2; ++h) {
+            __m512i sum = _mm512_sub_epi32(acc[r][h], _mm512_loadu_si512(b_offset + 16 * h));
+            __m512 scale = _mm512_mul_ps(a_scale, _mm512_loadu_ps(b_scales + 16 * h));
+            // Full-mask maskz form: the plain conversion trips a -Wuninitialized false positive in GCC 12's headers
+            _mm512_store_ps(tile + r * 32 + 16 * h, _mm512_mul_ps(_mm512_maskz_cvtepi32_ps(0xFFFF, sum), scale));
+        }
+    }
+}
+
+// 4x16 register tile with VPMADDWD: A and B are widened to int16 pairs, so each instruction multiplies a
+// broadcast pair of k from A with the same pair in 8 columns of B and adds both products to int32 lanes.
+// (VPMADDUBSW would take the bytes directly, but its int16 pair sums saturate for int8 x int8.)
+static void int8_micro_avx2_4x16(const uint32_t* a, int k2, const uint32_t* b, int ldb,
+                                 const float* a_scales, const float* b_scales, float* tile) {
+    __m256i acc[LOWP_ROWS_AVX2][2];
+#pragma GCC unroll 4
+    for (int r = 0; r < LOWP_ROWS_AVX2; ++r) {
+        acc[r][0] = _mm256_setzero_si256();
+        acc[r][1] = _mm256_setzero_si256();
+    }
+    for (int p = 0; p < k2; ++p) {
+        const uint32_t* b_row = b + static_cast<size_t>(p) * ldb;
+        __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b_row));
+        __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b_row + 8));
+#pragma GCC unroll 4
+        for (int r = 0; r < LOWP_ROWS_AVX2; ++r) {
+            __m256i a_pair = _mm256_set1_epi32(static_cast<int>(a[static_cast<size_t>(r) * k2 + p]));
+            acc[r][0] = _mm256_add_epi32(acc[r][0], _mm256_madd_epi16(a_pair, b0));
+            acc[r][1] = _mm256_add_epi32(acc[r][1], _mm256_madd_epi16(a_pair, b1));
+        }
+    }
+#pragma GCC unroll 4
+    for (int r = 0; r < LOWP_ROWS_AVX2; ++r) {
+        __m256 a_scale = _mm256_set1_ps(a_scales[r]);
+        for (int h = 0; h < 2; ++h) {
+            __m256 scale = _mm256_mul_ps(a_scale, _mm256_loadu_ps(b_scales + 8 * h));
+            _mm256_store_ps(tile + r * 16 + 8 * h, _mm256_mul_ps(_mm256_cvtepi32_ps(acc[r][h]), scale));
+        }
+    }
+}
+
+// Round n up to a whole number of 32-column register tiles
+static int lowp_padded_cols(int n) {
+    return (n + 31) / 32 * 32;
+}
+
+Matrix multiply_bf16(const BasicMatrix<bfloat16>& A, const BasicMatrix<bfloat16>& B) {
+    Matrix result(A.rows(), B.cols());
+    const int k = A.cols();
+    if (low_precision_support().avx512_bf16) {
+        // A's rows already hold their k pairs contiguously (the zero row padding covers an odd k)
+        const int k2 = (k + 1) / 2;
+        const int ldb = lowp_padded_cols(B.cols());
+        std::vector<uint32_t> b_pack = interleave_rows(B, 2, ldb, [](bfloat16 x) { return x.bits; });
+        lowp_for_tiles<LOWP_ROWS_AVX512, 32>(result, [&](int i, int rows) {
+            uint32_t* a = reinterpret_cast<uint32_t*>(gemm_workspace(2, static_cast<size_t>(LOWP_ROWS_AVX512) * k2));
+            for (int r = 0; r < LOWP_ROWS_AVX512; ++r) {
+                if (r < rows) {
+                    std::memcpy(a + static_cast<size_t>(r) * k2, A.row(i + r), k2 * sizeof(uint32_t));
+                } else {
+                    std::memset(a + static_cast<size_t>(r) * k2, 0, k2 * sizeof(uint32_t));
+                }
+            }
+            return static_cast<const uint32_t*>(a);
+        }, [&](const uint32_t* a, int, int j, float* tile) {
+            bf16_micro_avx512_8x32(a, k2, b_pack.data() + j, ldb, tile);
+        });
+    } else {
+        // Emulated: bf16 widens to fp32 with a 16-bit shift, so the F16C kernel works unchanged
+        const int k_pad = (k + 7) / 8 * 8;
+        lowp_for_tiles<LOWP_ROWS_AVX2, 16>(result, [&](int i, int rows) {
+            return widen_rows(A, i, rows, k_pad);
+        }, [&](const float* a, int, int j, float* tile) {
+            lowp_micro_avx2_4x16(a, k_pad, B, j, tile);
+        });
+    }
+    return result;
+}
+
+Matrix multiply_fp16(const BasicMatrix<float16>& A, const BasicMatrix<float16>& B) {
+    if (!low_precision_support().f16c) {
+        // No hardware conversion: widen once in software and use the fp32 engine
+        return multiply_optimized(to_fp32(A), to_fp32(B), 0, true, true);
+    }
+    Matrix result(A.rows(), B.cols());
+    const int k_pad = (A.cols() + 7) / 8 * 8;
+    lowp_for_tiles<LOWP_ROWS_AVX2, 16>(result, [&](int i, int rows) {
+        return widen_rows(A, i, rows, k_pad);
+    }, [&](const float* a, int, int j, float* tile) {
+        lowp_micro_avx2_4x16(a, k_pad, B, j, tile);
+    });
+    return result;
+}
+
+Matrix multiply_int8(const QuantizedMatrix& A, const QuantizedMatrix& B) {
+    if (A.per_column || !B.per_column) {
+        std::cerr << "Error: multiply_int8 needs A quantized per row and B per column" << std::endl;
+        return Matrix(A.values.rows(), B.values.cols());
+    }
+    const int m = A.values.rows();
+    const int k = A.values.cols();
+    const int n = B.values.cols();
+    const int ldb = lowp_padded_cols(n);
+    Matrix result(m, n);
+
+    // Scales padded with zeros so a partial register tile never reads past the end
+    std::vector<float> a_scales(A.scales);
+    a_scales.resize(m + LOWP_ROWS_AVX512, 0.0f);
+    std::vector<float> b_scales(B.scales);
+    b_scales.resize(ldb, 0.0f);
+
+    if (low_precision_support().avx512_vnni) {
+        const int k4 = (k + 3) / 4;
+        std::vector<uint32_t> b_pack = interleave_rows(B.values, 4, ldb, [](int8_t x) { return static_cast<uint8_t>(x); });
+        std::vector<int32_t> b_offset(ldb, 0);
+        for (int p = 0; p < k; ++p) {
+            const int8_t* b_row = B.values.row(p);
+            for (int j = 0; j < n; ++j) {
+                b_offset[j] += 128 * b_row[j];
+            }
+        }
+        lowp_for_tiles<LOWP_ROWS_AVX512, 32>(result, [&](int i, int rows) {
+            uint32_t* a = reinterpret_cast<uint32_t*>(gemm_workspace(2, static_cast<size_t>(LOWP_ROWS_AVX512) * k4));
+            for (int r = 0; r < LOWP_ROWS_AVX512; ++r) {
+                uint32_t* dst = a + static_cast<size_t>(r) * k4;
+                if (r < rows) {
+                    // Flipping the sign bit of each byte adds 128; the zero padding past k becomes 128 * 0 = 0
+                    std::memcpy(dst, A.values.row(i + r), k4 * sizeof(uint32_t));
+                    for (int p = 0; p < k4; ++p) {
+                        dst[p] ^= 0x80808080u;
+                    }
+                } else {
+                    std::memset(dst, 0, k4 * sizeof(uint32_t));
+                }
+            }
+            return static_cast<const uint32_t*>(a);
+        }, [&](const uint32_t* a, int i, int j, float* tile) {
+            int8_micro_vnni_8x32(a, k4, b_pack.data() + j, ldb, b_offset.data() + j, a_scales.data() + i, b_scales.data() + j, tile);
+        });
+    } else {
+        const int k2 = (k + 1) / 2;
+        auto widen = [](int8_t x) { return static_cast<uint16_t>(static_cast<int16_t>(x)); };
+        std::vector<uint32_t> b_pack = interleave_rows(B.values, 2, ldb, widen);
+        lowp_for_tiles<LOWP_ROWS_AVX2, 16>(result, [&](int i, int rows) {
+            uint32_t* a = reinterpret_cast<uint32_t*>(gemm_workspace(2, static_cast<size_t>(LOWP_ROWS_AVX2) * k2));
+            for (int r = 0; r < LOWP_ROWS_AVX2; ++r) {
+                uint32_t* dst = a + static_cast<size_t>(r) * k2;
+                const int8_t* src = r < rows ? A.values.row(i + r) : nullptr;
+                for (int p = 0; p < k2; ++p) {
+                    // The zero row padding supplies A(i, k) when k is odd
+                    dst[p] = src == nullptr ? 0u : widen(src[2 * p]) | static_cast<uint32_t>(widen(src[2 * p + 1])) << 16;
+                }
+            }
+            return static_cast<const uint32_t*>(a);
+        }, [&](const uint32_t* a, int i, int j, float* tile) {
+            int8_micro_avx2_4x16(a, k2, b_pack.data() + j, ldb, a_scales.data() + i, b_scales.data() + j, tile);
+        });
+    }
+    return result;
+}
+
+std::vector<PrecisionError> precision_accuracy_report(const Matrix& A, const Matrix& B) {
+    typedef std::chrono::high_resolution_clock Clock;
+    auto seconds = [](Clock::time_point start, Clock::time_point end) {
+        return std::chrono::duration<double>(end - start).count();
+    };
+
+    Matrix reference = multiply_native(A, B);
+    double reference_max = 0.0, reference_norm = 0.0;
+    for (int i = 0; i < reference.rows(); ++i) {
+        for (int j = 0; j < reference.cols(); ++j) {
+            double r = reference(i, j);
+            reference_max = std::max(reference_max, std::fabs(r));
+            reference_norm += r * r;
+        }
+    }
+    reference_norm = std::sqrt(reference_norm);
+
+    std::vector<PrecisionError> report;
+    auto record = [&](const std::string& name, double convert_s, double multiply_s, const Matrix& C) {
+        PrecisionError error = {name, convert_s, multiply_s, 0.0, 0.0, 0.0};
+        double diff_norm = 0.0;
+        for (int i = 0; i < C.rows(); ++i) {
+            for (int j = 0; j < C.cols(); ++j) {
+                double diff = std::fabs(static_cast<double>(C(i, j)) - reference(i, j));
+                error.max_abs_error = std::max(error.max_abs_error, diff);
+                diff_norm += diff * diff;
+            }
+        }
+        error.max_rel_error = reference_max > 0.0 ? error.max_abs_error / reference_max : 0.0;
+        error.rel_frobenius_error = reference_norm > 0.0 ? std::sqrt(diff_norm) / reference_norm : 0.0;
+        report.push_back(error);
+    };
+    const LowPrecisionSupport& support = low_precision_support();
+
+    // fp32 packed GEMM as the speed baseline
+    auto t0 = Clock::now();
+    Matrix C = multiply_optimized(A, B, 0, true, true);
+    auto t1 = Clock::now();
+    record("fp32 (optimized)", 0.0, seconds(t0, t1), C);
+
+    t0 = Clock::now();
+    BasicMatrix<bfloat16> A_bf16 = to_bf16(A), B_bf16 = to_bf16(B);
+    t1 = Clock::now();
+    C = multiply_bf16(A_bf16, B_bf16);
+    auto t2 = Clock::now();
+    record(support.avx512_bf16 ? "bf16 (AVX512_BF16)" : "bf16 (emulated)", seconds(t0, t1), seconds(t1, t2), C);
+
+    t0 = Clock::now();
+    BasicMatrix<float16> A_fp16 = to_fp16(A), B_fp16 = to_fp16(B);
+    t1 = Clock::now();
+    C = multiply_fp16(A_fp16, B_fp16);
+    t2 = Clock::now();
+    record(support.f16c ? "fp16 (F16C)" : "fp16 (software)", seconds(t0, t1), seconds(t1, t2), C);
+
+    t0 = Clock::now();
+    QuantizedMatrix A_int8 = quantize_int8(A, false), B_int8 = quantize_int8(B, true);
+    t1 = Clock::now();
+    C = multiply_int8(A_int8, B_int8);
+    t2 = Clock::now();
+    record(support.avx512_vnni ? "int8 (AVX512_VNNI)" : "int8 (AVX2)", seconds(t0, t1), seconds(t1, t2), C);
+    return report;
+}
+
+void print_precision_report(const std::vector<PrecisionError>& report) {
+    std::cout << "Accuracy against fp32 multiply_native:" << std::endl;
+    std::cout << "  kernel\t\t\tconvert_s\tmultiply_s\tmax_abs_err\tmax_rel_err\trel_frob_err" << std::endl;
+    for (const PrecisionError& error : report) {
+        std::cout << "  " << error.name << (error.name.size() < 16 ? "\t\t" : "\t") << error.convert_s << "\t\t"
+                  << error.multiply_s << "\t" << error.max_abs_error << "\t" << error.max_rel_error << "\t"
+                  << error.rel_frobenius_error << std::endl;
+    }
+}
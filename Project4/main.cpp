@@ -1,7 +1,6 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <unordered_map>
 #include <string>
 #include <thread>
 #include <mutex>
@@ -13,6 +12,19 @@
 #include <condition_variable>
 #include <cstdint>
 #include <cstring>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <string_view>
+#include <array>
+#include <numeric>
+#include <utility>
+#include <type_traits>
+#include <iterator>
+#include <fcntl.h>    // For mmap of column files
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // Timer for performance measurement
 class Timer {
@@ -29,69 +41,963 @@ public:
 };
 
 
-// Data Structures for Dictionary Encoding
-struct Dictionary {
-    std::unordered_map<std::string, int> data_to_id;
-    std::vector<std::string> id_to_data;
+// Dictionary strings in one contiguous arena plus a flat open-addressing index over them.
+// Entry `id` is arena[offsets[id] .. offsets[id] + lengths[id]), so every unique string is stored exactly once.
+// Each index slot holds a 64-bit word with a hash tag (upper 32 bits, never zero) and ID + 1 (lower 32 bits;
+// 0 while a concurrent insert is still publishing its string), followed by the entry's packed arena location.
+// A probe compares tags first, and a tag match reads the string straight from the arena.
+// IDs follow insertion order until sortByValue() renumbers them in lexicographic order of their strings, after
+// which prefixes and lexical ranges map to contiguous ID ranges.
+class Dictionary {
+    struct Slot {
+        std::atomic<uint64_t> word;
+        uint64_t location;   // offset << 24 | length, or a length of LONG_STRING to look up offsets/lengths
+    };
+    static constexpr uint64_t LONG_STRING = (1u << 24) - 1;
+
+    std::vector<char> arena;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> lengths;
+    std::vector<uint64_t> heads;   // first HEAD_BYTES bytes of each entry, zero-padded, for SIMD prefix filters
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;
+    size_t count = 0;
+    bool sorted = false;
+
+    // A fixed hash rather than std::hash, whose values are implementation-defined, so an index stored in a column
+    // file is valid whichever standard library reads it: each 8-byte little-endian word of the value is mixed in
+    // with a multiply by the 64-bit golden ratio, the last word zero-padded, then MurmurHash3's fmix64 finalizes.
+    static uint64_t hashOf(std::string_view value) {
+        constexpr uint64_t GOLDEN = 0x9E3779B97F4A7C15ull;
+        uint64_t hash = value.size() * GOLDEN;
+        size_t i = 0;
+        for (; i + 8 <= value.size(); i += 8) {
+            uint64_t word;
+            std::memcpy(&word, value.data() + i, 8);
+            hash = (hash ^ word) * GOLDEN;
+            hash ^= hash >> 32;
+        }
+        if (i < value.size()) {
+            uint64_t word = 0;
+            for (size_t byte = 0; i + byte < value.size(); ++byte) {
+                word |= uint64_t(static_cast<unsigned char>(value[i + byte])) << (8 * byte);
+            }
+            hash = (hash ^ word) * GOLDEN;
+            hash ^= hash >> 32;
+        }
+        hash ^= hash >> 33;
+        hash *= 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 33;
+        hash *= 0xC4CEB9FE1A85EC53ull;
+        hash ^= hash >> 33;
+        return hash;
+    }
+    static uint64_t tagOf(uint64_t hash) { return (hash >> 32) | 1u; }
+    static uint64_t slotWord(uint64_t tag, int id) { return tag << 32 | static_cast<uint32_t>(id + 1); }
+    static int slotId(uint64_t word) { return static_cast<int>(static_cast<uint32_t>(word)) - 1; }
+
+    static uint64_t headOf(std::string_view value) {
+        uint64_t head = 0;
+        std::memcpy(&head, value.data(), std::min(value.size(), HEAD_BYTES));
+        return head;
+    }
+
+    uint64_t locationOf(size_t id) const { return offsets[id] << 24 | std::min<uint64_t>(lengths[id], LONG_STRING); }
+
+    // String of a published slot; reads only the slot and the arena unless the string is very long
+    std::string_view slotValue(const Slot& slot, int id) const {
+        uint64_t length = slot.location & LONG_STRING;
+        if (length == LONG_STRING) {
+            return value(id);
+        }
+        return std::string_view(arena.data() + (slot.location >> 24), length);
+    }
+
+    // First ID in [0, count) for which before(id) is false, given that before() holds for a prefix of the IDs
+    template <typename Predicate>
+    int partitionPoint(Predicate before) const {
+        size_t first = 0;
+        size_t last = count;
+        while (first < last) {
+            size_t middle = first + (last - first) / 2;
+            if (before(middle)) {
+                first = middle + 1;
+            } else {
+                last = middle;
+            }
+        }
+        return static_cast<int>(first);
+    }
+
+    // Empty index with room for max_entries at a load factor of at most 1/2
+    static size_t slotCapacityFor(size_t max_entries) {
+        size_t capacity = 16;
+        while (capacity < 2 * max_entries) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    void allocateSlots(size_t max_entries) {
+        size_t capacity = slotCapacityFor(max_entries);
+        slots.reset(new Slot[capacity]());
+        mask = capacity - 1;
+    }
+
+    // Load a stored index of `capacity` slots, checking that every occupied slot names a distinct entry and that
+    // entry's own arena location, so probes never read outside the arena. As every entry occupies one slot and
+    // capacity is at least twice the count, some slot is empty and every probe ends. Tags are not rehashed: a
+    // wrong tag (past the file's CRC32C) can only make find miss. Returns false on any inconsistency.
+    bool loadIndex(const uint64_t* index_words, size_t capacity) {
+        slots.reset(new Slot[capacity]);
+        mask = capacity - 1;
+        std::vector<bool> seen(count);
+        size_t occupied = 0;
+        for (size_t slot = 0; slot < capacity; ++slot) {
+            uint64_t word = index_words[2 * slot];
+            uint64_t location = index_words[2 * slot + 1];
+            if (word != 0) {
+                size_t id = static_cast<uint32_t>(word) - uint64_t(1);
+                if (id >= count || seen[id] || location != locationOf(id)) {
+                    return false;
+                }
+                seen[id] = true;
+                ++occupied;
+            }
+            slots[slot].word.store(word, std::memory_order_relaxed);
+            slots[slot].location = location;
+        }
+        return occupied == count;
+    }
+
+    // Rebuild the index for max_entries and re-insert every entry (single-threaded use only)
+    void rebuildIndex(size_t max_entries) {
+        allocateSlots(max_entries);
+        for (size_t id = 0; id < count; ++id) {
+            uint64_t hash = hashOf(value(id));
+            size_t slot = hash & mask;
+            while (slots[slot].word.load(std::memory_order_relaxed) != 0) {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot].location = locationOf(id);
+            slots[slot].word.store(slotWord(tagOf(hash), static_cast<int>(id)), std::memory_order_relaxed);
+        }
+    }
+
+public:
+    static constexpr size_t HEAD_BYTES = sizeof(uint64_t);
+
+    size_t size() const { return count; }
+    bool isSorted() const { return sorted; }
+
+    std::string_view value(size_t id) const { return std::string_view(arena.data() + offsets[id], lengths[id]); }
+
+    // Bytes held by the arena, the offsets/lengths/heads and the index
+    size_t memoryBytes() const {
+        return arena.capacity() + offsets.capacity() * sizeof(uint64_t) + lengths.capacity() * sizeof(uint32_t) +
+               heads.capacity() * sizeof(uint64_t) + (slots ? (mask + 1) * sizeof(Slot) : 0);
+    }
+
+    // Total bytes of all strings in the arena
+    size_t arenaBytes() const { return arena.size(); }
+
+    // ID of `value`, or -1 if it does not occur in the column
+    int find(std::string_view value) const {
+        if (!slots) {
+            return -1;
+        }
+        uint64_t hash = hashOf(value);
+        uint64_t tag = tagOf(hash);
+        for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            uint64_t word = slots[slot].word.load(std::memory_order_relaxed);
+            if (word == 0) {
+                return -1;
+            }
+            if (word >> 32 == tag && slotValue(slots[slot], slotId(word)) == value) {
+                return slotId(word);
+            }
+        }
+    }
+
+    // ID of `value`, appending it as the next ID if it is new. Single-threaded; the index grows as needed.
+    int insert(std::string_view value) {
+        if (!slots || 2 * (count + 1) > mask + 1) {
+            rebuildIndex(std::max<size_t>(2 * count, 8));
+        }
+        uint64_t hash = hashOf(value);
+        uint64_t tag = tagOf(hash);
+        for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            uint64_t word = slots[slot].word.load(std::memory_order_relaxed);
+            if (word == 0) {
+                int id = static_cast<int>(count++);
+                sorted = false;
+                offsets.push_back(arena.size());
+                lengths.push_back(static_cast<uint32_t>(value.size()));
+                heads.push_back(headOf(value));
+                arena.insert(arena.end(), value.begin(), value.end());
+                slots[slot].location = locationOf(id);
+                slots[slot].word.store(slotWord(tag, id), std::memory_order_relaxed);
+                return id;
+            }
+            if (word >> 32 == tag && slotValue(slots[slot], slotId(word)) == value) {
+                return slotId(word);
+            }
+        }
+    }
+
+    // Drop any contents and size the arena and index for up to max_entries strings totalling max_bytes,
+    // ready for insertConcurrent
+    void reserveConcurrent(size_t max_entries, size_t max_bytes) {
+        allocateSlots(max_entries);
+        arena.assign(max_bytes, 0);
+        offsets.assign(max_entries, 0);
+        lengths.assign(max_entries, 0);
+        heads.assign(max_entries, 0);
+        count = 0;
+        sorted = false;
+    }
+
+    // insert() for many threads at once: an empty slot is claimed with a single compare-and-swap, the ID and
+    // the arena bytes come from the shared counters, and the slot is published once the string is in place.
+    // A thread only waits when it probes a slot whose string is still being published.
+    int insertConcurrent(std::string_view value, std::atomic<int>& next_id, std::atomic<uint64_t>& next_byte) {
+        uint64_t hash = hashOf(value);
+        uint64_t tag = tagOf(hash);
+        for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            uint64_t word = slots[slot].word.load(std::memory_order_acquire);
+            if (word == 0) {
+                if (slots[slot].word.compare_exchange_strong(word, tag << 32, std::memory_order_acq_rel)) {
+                    int id = next_id.fetch_add(1, std::memory_order_relaxed);
+                    uint64_t offset = next_byte.fetch_add(value.size(), std::memory_order_relaxed);
+                    std::memcpy(arena.data() + offset, value.data(), value.size());
+                    offsets[id] = offset;
+                    lengths[id] = static_cast<uint32_t>(value.size());
+                    heads[id] = headOf(value);
+                    slots[slot].location = locationOf(id);
+                    slots[slot].word.store(slotWord(tag, id), std::memory_order_release);
+                    return id;
+                }
+                // Another thread claimed this slot first; `word` now holds its contents
+            }
+            if (word >> 32 != tag) {
+                continue;
+            }
+            while (static_cast<uint32_t>(word) == 0) {
+                _mm_pause();
+                word = slots[slot].word.load(std::memory_order_acquire);
+            }
+            if (slotValue(slots[slot], slotId(word)) == value) {
+                return slotId(word);
+            }
+        }
+    }
+
+    // Trim the storage to what the concurrent inserts used; call after all of them have finished.
+    // The index was sized for the upper bound, so it is rebuilt whenever the real count fits a smaller one.
+    void finishConcurrent(int num_entries, uint64_t num_bytes) {
+        count = num_entries;
+        offsets.resize(count);
+        lengths.resize(count);
+        heads.resize(count);
+        arena.resize(num_bytes);
+        offsets.shrink_to_fit();
+        lengths.shrink_to_fit();
+        heads.shrink_to_fit();
+        arena.shrink_to_fit();
+        if (mask + 1 > slotCapacityFor(count)) {
+            rebuildIndex(count);
+        }
+    }
+
+    // The raw arrays, for writing the dictionary to a column file (heads are derived, and are not written)
+    const char* arenaData() const { return arena.data(); }
+    const uint64_t* offsetData() const { return offsets.data(); }
+    const uint32_t* lengthData() const { return lengths.data(); }
+    const uint64_t* headData() const { return heads.data(); }
+    size_t indexBytes() const { return slots ? (mask + 1) * 2 * sizeof(uint64_t) : 0; }
+
+    // The index as plain words, each slot's tag/ID word followed by its location, for writing to a column file
+    std::vector<uint64_t> indexWords() const {
+        std::vector<uint64_t> words(indexBytes() / sizeof(uint64_t));
+        for (size_t slot = 0; slot < words.size() / 2; ++slot) {
+            words[2 * slot] = slots[slot].word.load(std::memory_order_relaxed);
+            words[2 * slot + 1] = slots[slot].location;
+        }
+        return words;
+    }
+
+    // Replace the contents with arrays read back from a column file. The stored index (indexWords) is loaded
+    // slot by slot when it is consistent with the entries, so no string is rehashed; otherwise it is rebuilt.
+    // Returns false, leaving the dictionary empty, if an entry lies outside the arena.
+    bool assignFromArrays(const char* arena_data, size_t arena_bytes, const uint64_t* offset_data,
+                          const uint32_t* length_data, size_t num_entries, const uint64_t* index_words,
+                          size_t index_bytes, bool is_sorted) {
+        for (size_t id = 0; id < num_entries; ++id) {
+            if (offset_data[id] > arena_bytes || length_data[id] > arena_bytes - offset_data[id]) {
+                *this = Dictionary();
+                return false;
+            }
+        }
+        arena.assign(arena_data, arena_data + arena_bytes);
+        offsets.assign(offset_data, offset_data + num_entries);
+        lengths.assign(length_data, length_data + num_entries);
+        heads.resize(num_entries);
+        for (size_t id = 0; id < num_entries; ++id) {
+            heads[id] = headOf(value(id));
+        }
+        count = num_entries;
+        sorted = is_sorted;
+
+        size_t capacity = index_bytes / (2 * sizeof(uint64_t));
+        if (index_bytes % (2 * sizeof(uint64_t)) != 0 || capacity != slotCapacityFor(count) ||
+            !loadIndex(index_words, capacity)) {
+            rebuildIndex(count);
+        }
+        return true;
+    }
+
+    // Renumber the entries in lexicographic order of their strings, rewriting the arena in that order.
+    // Returns the old ID -> new ID mapping for remapping encoded data.
+    std::vector<int> sortByValue() {
+        std::vector<int> order(count);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [this](int a, int b) { return value(a) < value(b); });
+
+        std::vector<char> sorted_arena;
+        std::vector<uint64_t> sorted_offsets(count);
+        std::vector<uint32_t> sorted_lengths(count);
+        std::vector<uint64_t> sorted_heads(count);
+        std::vector<int> old_to_new(count);
+        sorted_arena.reserve(arena.size());
+        for (size_t new_id = 0; new_id < count; ++new_id) {
+            std::string_view entry = value(order[new_id]);
+            old_to_new[order[new_id]] = static_cast<int>(new_id);
+            sorted_offsets[new_id] = sorted_arena.size();
+            sorted_lengths[new_id] = static_cast<uint32_t>(entry.size());
+            sorted_heads[new_id] = heads[order[new_id]];
+            sorted_arena.insert(sorted_arena.end(), entry.begin(), entry.end());
+        }
+        arena.swap(sorted_arena);
+        offsets.swap(sorted_offsets);
+        lengths.swap(sorted_lengths);
+        heads.swap(sorted_heads);
+        rebuildIndex(count);
+        sorted = true;
+        return old_to_new;
+    }
+
+    // First ID whose string is not less than `key` (sorted dictionaries only)
+    int lowerBound(std::string_view key) const {
+        return partitionPoint([&](size_t id) { return value(id) < key; });
+    }
+
+    // IDs [first, last) of the strings starting with `prefix` (sorted dictionaries only)
+    std::pair<int, int> prefixRange(std::string_view prefix) const {
+        int first = lowerBound(prefix);
+        int last = partitionPoint([&](size_t id) { return value(id).substr(0, prefix.size()) <= prefix; });
+        return {first, last};
+    }
+};
+
+// Dictionary IDs bit-packed at ceil(log2(cardinality)) bits each, in the vertical layout of SIMD-BP128:
+// a block of BLOCK_ROWS rows is 16 interleaved lanes of 32-bit words, and row b * BLOCK_ROWS + k * 16 + l
+// sits in lane l at bit offset k * bits. One vector load therefore advances 16 consecutive rows at once,
+// and unpacking is the same shift and mask in every lane. The last block is zero-padded.
+class PackedColumn {
+    std::shared_ptr<uint32_t[]> words;   // owned, or a view into a mapped column file (shared on copy)
+    size_t num_words = 0;
+    size_t count = 0;
+    int bits = 1;
+
+public:
+    static constexpr size_t LANES = 16;
+    static constexpr size_t BLOCK_ROWS = LANES * 32;
+
+    // Narrowest width that holds every ID below `cardinality`
+    static int bitWidthFor(size_t cardinality) {
+        int width = 1;
+        while (width < 32 && (uint64_t(1) << width) < cardinality) {
+            ++width;
+        }
+        return width;
+    }
+
+    size_t size() const { return count; }
+    int bitWidth() const { return bits; }
+    size_t numBlocks() const { return (count + BLOCK_ROWS - 1) / BLOCK_ROWS; }
+    size_t memoryBytes() const { return num_words * sizeof(uint32_t); }
+    const uint32_t* wordData() const { return words.get(); }
+
+    // Words a column of `rows` IDs at `width` bits occupies
+    static size_t wordsFor(size_t rows, int width) { return (rows + BLOCK_ROWS - 1) / BLOCK_ROWS * width * LANES; }
+
+    // The bits * LANES words of block `block`
+    const uint32_t* blockWords(size_t block) const { return words.get() + block * bits * LANES; }
+
+    // Zeroed storage for `rows` IDs below `cardinality`, to be filled by packBlocks
+    void reset(size_t rows, size_t cardinality) {
+        count = rows;
+        bits = bitWidthFor(cardinality);
+        num_words = wordsFor(rows, bits);
+        words.reset(new uint32_t[num_words]());
+    }
+
+    // Read-only view of `rows` IDs packed at `width` bits in `data`, which must hold wordsFor(rows, width) words
+    // and stays alive as long as any copy of this column
+    void assignView(std::shared_ptr<uint32_t[]> data, size_t rows, int width) {
+        words = std::move(data);
+        count = rows;
+        bits = width;
+        num_words = wordsFor(rows, width);
+    }
+
+    // Pack ids[first_block * BLOCK_ROWS ..] up to last_block; distinct block ranges may be packed concurrently
+    void packBlocks(const int* ids, size_t first_block, size_t last_block) {
+        for (size_t block = first_block; block < last_block; ++block) {
+            uint32_t* out = words.get() + block * bits * LANES;
+            size_t block_start = block * BLOCK_ROWS;
+            for (size_t k = 0; k < 32; ++k) {
+                size_t word = k * bits / 32;
+                int shift = k * bits % 32;
+                for (size_t lane = 0; lane < LANES; ++lane) {
+                    size_t row = block_start + k * LANES + lane;
+                    uint32_t value = row < count ? static_cast<uint32_t>(ids[row]) : 0;
+                    out[word * LANES + lane] |= value << shift;
+                    if (shift + bits > 32) {
+                        out[(word + 1) * LANES + lane] |= value >> (32 - shift);
+                    }
+                }
+            }
+        }
+    }
+
+    // ID of one row
+    uint32_t get(size_t row) const {
+        const uint32_t* in = blockWords(row / BLOCK_ROWS);
+        size_t k = row % BLOCK_ROWS / LANES;
+        size_t lane = row % LANES;
+        size_t word = k * bits / 32;
+        int shift = k * bits % 32;
+        uint64_t value = in[word * LANES + lane] >> shift;
+        if (shift + bits > 32) {
+            value |= uint64_t(in[(word + 1) * LANES + lane]) << (32 - shift);
+        }
+        return static_cast<uint32_t>(value & ((uint64_t(1) << bits) - 1));
+    }
+};
+
+// Summary of one zone of the column: the range of its IDs and a Bloom filter of which IDs occur in it, so a
+// scan can skip zones that cannot hold the IDs it looks for
+struct ColumnZone {
+    static constexpr size_t BLOOM_BITS = 4096;
+
+    uint32_t min_id = UINT32_MAX;
+    uint32_t max_id = 0;
+    uint64_t bloom[BLOOM_BITS / 64] = {};
+
+    void add(uint32_t id) {
+        min_id = std::min(min_id, id);
+        max_id = std::max(max_id, id);
+        uint64_t hash = id * 0x9E3779B97F4A7C15ull;
+        bloom[(hash >> 52) / 64] |= uint64_t(1) << (hash >> 52) % 64;
+        bloom[(hash >> 40) % BLOOM_BITS / 64] |= uint64_t(1) << (hash >> 40) % 64;
+    }
+
+    bool overlaps(uint32_t lo, uint32_t hi) const { return lo <= max_id && min_id <= hi; }
+
+    // False only if `id` does not occur in the zone
+    bool mayContain(uint32_t id) const {
+        if (!overlaps(id, id)) {
+            return false;
+        }
+        uint64_t hash = id * 0x9E3779B97F4A7C15ull;
+        return (bloom[(hash >> 52) / 64] >> (hash >> 52) % 64 & 1) &&
+               (bloom[(hash >> 40) % BLOOM_BITS / 64] >> (hash >> 40) % 64 & 1);
+    }
+};
+
+// Inverted index over a column: for each dictionary ID, the ascending rows that hold it. A list holding at least
+// one row in 8 is stored as a bitmap with one bit per row of the column; any other list is stored as the gaps
+// between its rows (the first counted from row 0) in LEB128 varints, 7 bits per byte. The lists lie back to back
+// in one byte array, and a lookup decodes only the lists it asks for.
+class PostingIndex {
+    std::vector<uint64_t> offsets;      // list of ID i is bytes [offsets[i], offsets[i + 1]); empty if not built
+    std::vector<uint32_t> counts;       // rows per ID
+    std::shared_ptr<uint8_t[]> bytes;   // owned, or a view into a mapped column file (shared on copy)
+    size_t num_bytes = 0;
+    size_t num_rows = 0;
+
+    // Call f(row) for each row of list `id`, ascending. Stops at the end of the list or the column, so a corrupt
+    // list cannot yield a row past the column.
+    template <typename F>
+    void forEachRow(size_t id, const F& f) const {
+        const uint8_t* in = bytes.get() + offsets[id];
+        const uint8_t* end = bytes.get() + offsets[id + 1];
+        if (isBitmap(counts[id], num_rows)) {
+            for (size_t i = 0; i < (num_rows + 63) / 64; ++i) {
+                uint64_t word;
+                std::memcpy(&word, in + i * sizeof(word), sizeof(word));
+                for (; word; word &= word - 1) {
+                    size_t row = i * 64 + __builtin_ctzll(word);
+                    if (row >= num_rows) {
+                        return;
+                    }
+                    f(row);
+                }
+            }
+            return;
+        }
+        size_t row = 0;
+        while (in < end) {
+            uint64_t gap = *in++;
+            if (gap & 0x80) {   // rare: most gaps fit in one byte
+                gap &= 0x7F;
+                for (int shift = 7; in < end && shift < 64; shift += 7) {
+                    uint8_t byte = *in++;
+                    gap |= uint64_t(byte & 0x7F) << shift;
+                    if (!(byte & 0x80)) {
+                        break;
+                    }
+                }
+            }
+            row += gap;
+            if (row >= num_rows) {
+                return;
+            }
+            f(row);
+        }
+    }
+
+    // Emit the set bits of a bitmap over the column as 16-row masks, ascending
+    template <typename Emit>
+    void emitBitmap(const uint8_t* data, Emit& emit) const {
+        for (size_t i = 0; i < (num_rows + 63) / 64; ++i) {
+            uint64_t word;
+            std::memcpy(&word, data + i * sizeof(word), sizeof(word));
+            if (i == num_rows / 64) {
+                word &= (uint64_t(1) << (num_rows % 64)) - 1;   // a partial last word
+            }
+            while (word) {
+                int group = __builtin_ctzll(word) & ~15;
+                emit(static_cast<uint32_t>(word >> group) & 0xFFFF, i * 64 + group);
+                word &= ~(uint64_t(0xFFFF) << group);
+            }
+        }
+    }
+
+public:
+    // Bytes of a list stored as a bitmap over `rows` rows
+    static size_t bitmapBytes(size_t rows) { return (rows + 63) / 64 * sizeof(uint64_t); }
+
+    // From one row in 8 on, a bitmap is no larger than the gaps, which take at least a byte each
+    static bool isBitmap(size_t count, size_t rows) { return count > 0 && count * 8 >= rows; }
+
+    // Bytes of the LEB128 varint for `value`
+    static size_t varintBytes(uint64_t value) {
+        size_t length = 1;
+        while (value >= 0x80) {
+            value >>= 7;
+            ++length;
+        }
+        return length;
+    }
+
+    // Write `value` as a LEB128 varint at `out`; returns the byte past it
+    static uint8_t* writeVarint(uint64_t value, uint8_t* out) {
+        while (value >= 0x80) {
+            *out++ = static_cast<uint8_t>(value | 0x80);
+            value >>= 7;
+        }
+        *out++ = static_cast<uint8_t>(value);
+        return out;
+    }
+
+    bool built() const { return !offsets.empty(); }
+    size_t numIds() const { return counts.size(); }
+    size_t numRows() const { return num_rows; }
+    size_t count(size_t id) const { return counts[id]; }
+    size_t memoryBytes() const { return num_bytes + offsets.size() * sizeof(uint64_t) + counts.size() * sizeof(uint32_t); }
+
+    const uint64_t* offsetData() const { return offsets.data(); }
+    const uint32_t* countData() const { return counts.data(); }
+    const uint8_t* byteData() const { return bytes.get(); }
+    size_t byteSize() const { return num_bytes; }
+
+    // Take lists over a column of `rows` rows: num_ids + 1 offsets into `data`, which holds data_bytes bytes and
+    // stays alive as long as any copy of this index, and num_ids counts. False, leaving the index unbuilt, if the
+    // offsets do not lay the lists out back to back or a bitmap list has the wrong size.
+    bool assign(std::vector<uint64_t> list_offsets, std::vector<uint32_t> list_counts, std::shared_ptr<uint8_t[]> data,
+                size_t data_bytes, size_t rows) {
+        bool valid = list_offsets.size() == list_counts.size() + 1 && list_offsets.front() == 0 &&
+                     list_offsets.back() == data_bytes;
+        for (size_t id = 0; id < list_counts.size() && valid; ++id) {
+            uint64_t list_bytes = list_offsets[id + 1] - list_offsets[id];
+            valid = list_offsets[id] <= list_offsets[id + 1] && list_counts[id] <= rows &&
+                    (!isBitmap(list_counts[id], rows) || list_bytes == bitmapBytes(rows));
+        }
+        if (!valid) {
+            *this = PostingIndex();
+            return false;
+        }
+        offsets = std::move(list_offsets);
+        counts = std::move(list_counts);
+        bytes = std::move(data);
+        num_bytes = data_bytes;
+        num_rows = rows;
+        return true;
+    }
+
+    // Emit the rows holding any of `ids` as 16-row masks in ascending order, like the column scans; IDs outside
+    // the index are ignored. Lists totalling under one row in 64 are decoded and grouped into masks directly
+    // (merged by sorting if there are several). Otherwise the lists are ORed into a bitmap over the column,
+    // which costs no branch per row, and the bitmap is emitted; a single bitmap list is emitted as it is.
+    template <typename Emit>
+    void lookup(std::vector<int> ids, Emit& emit) const {
+        ids.erase(std::remove_if(ids.begin(), ids.end(),
+                                 [&](int id) { return id < 0 || static_cast<size_t>(id) >= counts.size() || counts[id] == 0; }),
+                  ids.end());
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        if (ids.empty()) {
+            return;
+        }
+        if (ids.size() == 1 && isBitmap(counts[ids[0]], num_rows)) {
+            emitBitmap(bytes.get() + offsets[ids[0]], emit);
+            return;
+        }
+
+        size_t total = 0;
+        for (int id : ids) {
+            total += counts[id];
+        }
+        if (total < num_rows / 64) {
+            uint32_t mask = 0;
+            size_t group = 0;
+            auto add = [&](size_t row) {
+                if (row / 16 * 16 != group && mask) {
+                    emit(mask, group);
+                    mask = 0;
+                }
+                group = row / 16 * 16;
+                mask |= 1u << (row % 16);
+            };
+            if (ids.size() == 1) {
+                forEachRow(ids[0], add);
+            } else {
+                std::vector<uint32_t> rows;
+                rows.reserve(total);
+                for (int id : ids) {
+                    forEachRow(id, [&](size_t row) { rows.push_back(static_cast<uint32_t>(row)); });
+                }
+                std::sort(rows.begin(), rows.end());
+                for (uint32_t row : rows) {
+                    add(row);
+                }
+            }
+            if (mask) {
+                emit(mask, group);
+            }
+            return;
+        }
+
+        std::vector<uint64_t> words((num_rows + 63) / 64, 0);
+        for (int id : ids) {
+            if (isBitmap(counts[id], num_rows)) {
+                const uint8_t* in = bytes.get() + offsets[id];
+                for (size_t i = 0; i < words.size(); ++i) {
+                    uint64_t word;
+                    std::memcpy(&word, in + i * sizeof(word), sizeof(word));
+                    words[i] |= word;
+                }
+            } else {
+                forEachRow(id, [&](size_t row) { words[row / 64] |= uint64_t(1) << (row % 64); });
+            }
+        }
+        emitBitmap(reinterpret_cast<const uint8_t*>(words.data()), emit);
+    }
 };
 
 struct EncodedColumn {
+    static constexpr size_t ZONE_ROWS = size_t(1) << 16;   // a whole number of packed blocks
+
     Dictionary dictionary;
-    std::vector<int> encoded_data;
+    std::vector<int> encoded_data;   // empty for a column opened from a binary file
+    PackedColumn packed_data;        // filled by packEncodedColumn or mapped by openEncodedColumnFile
+    std::vector<uint8_t> narrow_data;   // IDs at narrow_width bytes each, filled by narrowEncodedColumn
+    int narrow_width = 0;               // 1 or 2; 0 when the IDs need all 32 bits
+    std::vector<ColumnZone> zones;   // zone z covers rows [z * ZONE_ROWS, (z + 1) * ZONE_ROWS); empty if not built
+    PostingIndex postings;           // filled by buildPostingIndex; unbuilt unless asked for
+
+    size_t size() const { return encoded_data.empty() ? packed_data.size() : encoded_data.size(); }
+    bool hasPackedData() const { return packed_data.size() == size(); }
+    bool hasNarrowData() const { return narrow_width > 0 && narrow_data.size() == size() * narrow_width; }
+    bool hasPostings() const { return postings.built() && postings.numRows() == size() && postings.numIds() == dictionary.size(); }
+    int id(size_t row) const { return encoded_data.empty() ? packed_data.get(row) : encoded_data[row]; }
 };
 
+// Fill encoded_column.zones from its IDs, each thread summarising a contiguous run of zones
+void buildZoneMap(EncodedColumn& encoded_column, int num_threads) {
+    size_t rows = encoded_column.size();
+    size_t num_zones = (rows + EncodedColumn::ZONE_ROWS - 1) / EncodedColumn::ZONE_ROWS;
+    encoded_column.zones.assign(num_zones, ColumnZone());
+
+    size_t zones_per_thread = (num_zones + num_threads - 1) / std::max(num_threads, 1);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        size_t first = t * zones_per_thread;
+        size_t last = std::min(first + zones_per_thread, num_zones);
+        if (first < last) {
+            threads.emplace_back([&, first, last] {
+                for (size_t zone = first; zone < last; ++zone) {
+                    size_t end = std::min((zone + 1) * EncodedColumn::ZONE_ROWS, rows);
+                    for (size_t row = zone * EncodedColumn::ZONE_ROWS; row < end; ++row) {
+                        encoded_column.zones[zone].add(encoded_column.id(row));
+                    }
+                }
+            });
+        }
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Fill encoded_column.postings from its IDs with a parallel counting sort. Each thread counts the IDs of a
+// contiguous run of rows and then files those rows under their IDs, at offsets that keep every list ascending.
+// The lists are then encoded in parallel, each thread taking the IDs that cover about an equal share of rows.
+void buildPostingIndex(EncodedColumn& encoded_column, int num_threads) {
+    size_t rows = encoded_column.size();
+    size_t num_ids = encoded_column.dictionary.size();
+    num_threads = std::max(num_threads, 1);
+    size_t rows_per_thread = (rows + num_threads - 1) / num_threads;
+    auto onEachThread = [&](const auto& work) {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < num_threads; ++t) {
+            threads.emplace_back(work, t);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    };
+
+    // cursors[t][id]: first the rows of thread t holding id, then where thread t files its next such row
+    std::vector<std::vector<uint32_t>> cursors(num_threads, std::vector<uint32_t>(num_ids, 0));
+    onEachThread([&](int t) {
+        size_t end = std::min((t + 1) * rows_per_thread, rows);
+        for (size_t row = t * rows_per_thread; row < end; ++row) {
+            ++cursors[t][encoded_column.id(row)];
+        }
+    });
+    std::vector<uint32_t> counts(num_ids);
+    std::vector<uint64_t> list_start(num_ids + 1, 0);
+    uint32_t position = 0;
+    for (size_t id = 0; id < num_ids; ++id) {
+        list_start[id] = position;
+        for (int t = 0; t < num_threads; ++t) {
+            uint32_t rows_here = cursors[t][id];
+            cursors[t][id] = position;
+            position += rows_here;
+        }
+        counts[id] = static_cast<uint32_t>(position - list_start[id]);
+    }
+    list_start[num_ids] = position;
+
+    std::vector<uint32_t> sorted_rows(rows);
+    onEachThread([&](int t) {
+        size_t end = std::min((t + 1) * rows_per_thread, rows);
+        for (size_t row = t * rows_per_thread; row < end; ++row) {
+            sorted_rows[cursors[t][encoded_column.id(row)]++] = static_cast<uint32_t>(row);
+        }
+    });
+    std::vector<std::vector<uint32_t>>().swap(cursors);
+
+    // Thread t encodes IDs [first_id[t], first_id[t + 1]), whose lists start in its share of sorted_rows
+    std::vector<size_t> first_id(num_threads + 1, num_ids);
+    for (int t = 0; t < num_threads; ++t) {
+        first_id[t] = std::lower_bound(list_start.begin(), list_start.end() - 1, t * rows_per_thread) - list_start.begin();
+    }
+    first_id[0] = 0;
+
+    std::vector<uint64_t> offsets(num_ids + 1, 0);
+    onEachThread([&](int t) {
+        for (size_t id = first_id[t]; id < first_id[t + 1]; ++id) {
+            size_t list_bytes = 0;
+            if (PostingIndex::isBitmap(counts[id], rows)) {
+                list_bytes = PostingIndex::bitmapBytes(rows);
+            } else {
+                uint32_t previous = 0;
+                for (uint64_t i = list_start[id]; i < list_start[id + 1]; ++i) {
+                    list_bytes += PostingIndex::varintBytes(sorted_rows[i] - previous);
+                    previous = sorted_rows[i];
+                }
+            }
+            offsets[id + 1] = list_bytes;
+        }
+    });
+    for (size_t id = 0; id < num_ids; ++id) {
+        offsets[id + 1] += offsets[id];
+    }
+
+    size_t total_bytes = offsets[num_ids];
+    std::shared_ptr<uint8_t[]> data(new uint8_t[total_bytes]());
+    onEachThread([&](int t) {
+        for (size_t id = first_id[t]; id < first_id[t + 1]; ++id) {
+            uint8_t* out = data.get() + offsets[id];
+            if (PostingIndex::isBitmap(counts[id], rows)) {
+                for (uint64_t i = list_start[id]; i < list_start[id + 1]; ++i) {
+                    out[sorted_rows[i] / 8] |= uint8_t(1) << (sorted_rows[i] % 8);
+                }
+            } else {
+                uint32_t previous = 0;
+                for (uint64_t i = list_start[id]; i < list_start[id + 1]; ++i) {
+                    out = PostingIndex::writeVarint(sorted_rows[i] - previous, out);
+                    previous = sorted_rows[i];
+                }
+            }
+        }
+    });
+    encoded_column.postings.assign(std::move(offsets), std::move(counts), std::move(data), total_bytes, rows);
+}
+
 // Thread worker for encoding chunks
 void encodeChunk(
     const std::vector<std::string>& input_data, 
     size_t start, 
     size_t end, 
-    std::unordered_map<std::string, int>& local_dict, 
-    std::vector<std::string>& local_id_to_data, 
+    Dictionary& local_dict, 
     std::vector<int>& encoded_chunk) {
 
+    encoded_chunk.reserve(end - start);
     for (size_t i = start; i < end; ++i) {
-        const auto& item = input_data[i];
-        if (local_dict.find(item) == local_dict.end()) {
-            int id = static_cast<int>(local_id_to_data.size());
-            local_dict[item] = id;
-            local_id_to_data.push_back(item);
-        }
-        encoded_chunk.push_back(local_dict[item]);
+        encoded_chunk.push_back(local_dict.insert(input_data[i]));
+    }
+}
+
+// Thread worker for encoding newline-separated text in place, e.g. a range of a mapped file. Each row is a
+// string_view into the text, so no per-row std::string is built. Rows split like std::getline: a last row
+// without a newline still counts, and a trailing newline adds no empty row.
+void encodeChunk(const char* begin, const char* end, Dictionary& local_dict, std::vector<int>& encoded_chunk) {
+    while (begin < end) {
+        const char* newline = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+        const char* row_end = newline ? newline : end;
+        encoded_chunk.push_back(local_dict.insert(std::string_view(begin, row_end - begin)));
+        begin = row_end + 1;
     }
 }
 
-// Merge local dictionaries into the global dictionary
+// Merge one thread's local dictionary into the shared global dictionary, recording local ID -> global ID
+// in a dense vector. Runs concurrently for all threads.
 void mergeDictionaries(
-    const std::unordered_map<std::string, int>& local_dict, 
-    const std::vector<std::string>& local_id_to_data, 
+    const Dictionary& local_dict, 
     Dictionary& global_dict, 
-    std::unordered_map<int, int>& local_to_global_map, 
-    std::mutex& global_mutex) {
+    std::atomic<int>& next_id, 
+    std::atomic<uint64_t>& next_byte, 
+    std::vector<int>& local_to_global) {
 
-    for (size_t local_id = 0; local_id < local_id_to_data.size(); ++local_id) {
-        const std::string& item = local_id_to_data[local_id];
-        std::lock_guard<std::mutex> lock(global_mutex);
-        if (global_dict.data_to_id.find(item) == global_dict.data_to_id.end()) {
-            int global_id = static_cast<int>(global_dict.id_to_data.size());
-            global_dict.data_to_id[item] = global_id;
-            global_dict.id_to_data.push_back(item);
+    local_to_global.resize(local_dict.size());
+    for (size_t local_id = 0; local_id < local_dict.size(); ++local_id) {
+        local_to_global[local_id] = global_dict.insertConcurrent(local_dict.value(local_id), next_id, next_byte);
+    }
+}
+
+// Merge the per-thread local dictionaries into one global dictionary and write every chunk out in global IDs,
+// chunk t following chunk t - 1 in the column, then build the zone map. With sorted_dictionary the IDs follow the lexicographic order of
+// the values (see Dictionary::sortByValue), otherwise they depend on thread timing. With posting_lists the
+// posting index is built too.
+EncodedColumn mergeEncodedChunks(
+    const std::vector<Dictionary>& local_dicts, 
+    const std::vector<std::vector<int>>& local_encoded_chunks, 
+    bool sorted_dictionary,
+    bool posting_lists = false) {
+
+    int num_threads = static_cast<int>(local_dicts.size());
+    EncodedColumn encoded_column;
+
+    // Where each chunk starts in the column
+    std::vector<size_t> chunk_start(num_threads + 1, 0);
+    for (int t = 0; t < num_threads; ++t) {
+        chunk_start[t + 1] = chunk_start[t] + local_encoded_chunks[t].size();
+    }
+    encoded_column.encoded_data.resize(chunk_start[num_threads]);
+
+    // The local dictionaries bound the number and total size of the unique values, which sizes the global one
+    size_t max_unique = 0;
+    size_t max_bytes = 0;
+    for (int t = 0; t < num_threads; ++t) {
+        max_unique += local_dicts[t].size();
+        max_bytes += local_dicts[t].arenaBytes();
+    }
+    Dictionary& dictionary = encoded_column.dictionary;
+    dictionary.reserveConcurrent(max_unique, max_bytes);
+    std::atomic<int> next_id(0);
+    std::atomic<uint64_t> next_byte(0);
+
+    // Rewrite thread t's chunk in global IDs
+    std::vector<std::vector<int>> local_to_global_maps(num_threads);
+    auto remapChunk = [&](int t) {
+        const std::vector<int>& local_to_global = local_to_global_maps[t];
+        const std::vector<int>& chunk = local_encoded_chunks[t];
+        int* out = encoded_column.encoded_data.data() + chunk_start[t];
+        for (size_t i = 0; i < chunk.size(); ++i) {
+            out[i] = local_to_global[chunk[i]];
+        }
+    };
+
+    // Merge into the global dictionary and remap each chunk to global IDs, all threads at once. A sorted
+    // dictionary only knows its final IDs once every merge is done, so it remaps in a second parallel pass.
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        if (local_encoded_chunks[t].empty()) {
+            continue;
+        }
+        threads.emplace_back([&, t] {
+            mergeDictionaries(local_dicts[t], dictionary, next_id, next_byte, local_to_global_maps[t]);
+            if (!sorted_dictionary) {
+                remapChunk(t);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    dictionary.finishConcurrent(next_id.load(), next_byte.load());
+
+    if (sorted_dictionary) {
+        std::vector<int> old_to_new = dictionary.sortByValue();
+        for (int t = 0; t < num_threads; ++t) {
+            if (local_encoded_chunks[t].empty()) {
+                continue;
+            }
+            threads.emplace_back([&, t] {
+                for (int& id : local_to_global_maps[t]) {
+                    id = old_to_new[id];
+                }
+                remapChunk(t);
+            });
         }
-        local_to_global_map[local_id] = global_dict.data_to_id[item];
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    buildZoneMap(encoded_column, num_threads);
+    if (posting_lists) {
+        buildPostingIndex(encoded_column, num_threads);
     }
+    return encoded_column;
 }
 
-// Perform dictionary encoding with multithreading
-EncodedColumn encodeDictionary(const std::vector<std::string>& input_data, int num_threads) {
+// Perform dictionary encoding with multithreading; see mergeEncodedChunks for sorted_dictionary and posting_lists
+EncodedColumn encodeDictionary(const std::vector<std::string>& input_data, int num_threads, bool sorted_dictionary = false,
+                               bool posting_lists = false) {
     size_t data_size = input_data.size();
-    EncodedColumn encoded_column;
-    encoded_column.encoded_data.resize(data_size);
 
     // Determine chunk size
     size_t chunk_size = (data_size + num_threads - 1) / num_threads;
 
     // Thread-specific structures
-    std::vector<std::unordered_map<std::string, int>> local_dicts(num_threads);
-    std::vector<std::vector<std::string>> local_id_to_data(num_threads);
+    std::vector<Dictionary> local_dicts(num_threads);
     std::vector<std::vector<int>> local_encoded_chunks(num_threads);
 
     // Launch threads to process chunks
@@ -101,110 +1007,1256 @@ EncodedColumn encodeDictionary(const std::vector<std::string>& input_data, int n
         size_t end = std::min(start + chunk_size, data_size);
 
         if (start < end) {
-            threads.emplace_back(
-                encodeChunk,
-                std::cref(input_data),
-                start,
-                end,
-                std::ref(local_dicts[t]),
-                std::ref(local_id_to_data[t]),
-                std::ref(local_encoded_chunks[t]));
+            threads.emplace_back([&, t, start, end] {
+                encodeChunk(input_data, start, end, local_dicts[t], local_encoded_chunks[t]);
+            });
+        }
+    }
+
+    // Wait for all threads to complete
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    return mergeEncodedChunks(local_dicts, local_encoded_chunks, sorted_dictionary, posting_lists);
+}
+
+// A read-only mapping of a whole file, unmapped when the last reference goes away. An empty file maps to
+// no bytes; nullptr means the file could not be opened or mapped.
+struct MappedFile {
+    const char* data = nullptr;
+    size_t bytes = 0;
+
+    ~MappedFile() {
+        if (data) {
+            munmap(const_cast<char*>(data), bytes);
+        }
+    }
+};
+
+std::shared_ptr<MappedFile> mapFile(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    auto mapping = std::make_shared<MappedFile>();
+    bool mapped = fstat(fd, &info) == 0;
+    if (mapped && info.st_size > 0) {
+        void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        mapped = data != MAP_FAILED;
+        if (mapped) {
+            mapping->data = static_cast<const char*>(data);
+            mapping->bytes = info.st_size;
+        }
+    }
+    close(fd);
+    return mapped ? mapping : nullptr;
+}
+
+// Ingest and encode a newline-separated text file as one parallel pipeline. The file is mapped and split at
+// newline boundaries into one byte range per thread, and each thread encodes its rows straight from the
+// mapping. No row is ever copied into a std::string; the dictionary copies each unique value once.
+EncodedColumn encodeColumnFile(const std::string& filename, int num_threads, bool sorted_dictionary = false,
+                               bool posting_lists = false) {
+    std::shared_ptr<MappedFile> mapping = mapFile(filename);
+    if (!mapping) {
+        std::cerr << "Error: Unable to map input file: " << filename << "\n";
+        return EncodedColumn();
+    }
+    const char* text = mapping->data;
+    size_t bytes = mapping->bytes;
+    if (bytes > 0) {
+        madvise(const_cast<char*>(text), bytes, MADV_SEQUENTIAL);
+    }
+
+    // Thread t starts just past the first newline at or after its even share of the bytes, so every row
+    // belongs to exactly one thread
+    std::vector<size_t> range_start(num_threads + 1, bytes);
+    range_start[0] = 0;
+    for (int t = 1; t < num_threads; ++t) {
+        size_t nominal = bytes / num_threads * t;
+        if (nominal <= range_start[t - 1]) {
+            range_start[t] = range_start[t - 1];
+            continue;
+        }
+        const char* newline = static_cast<const char*>(std::memchr(text + nominal - 1, '\n', bytes - nominal + 1));
+        range_start[t] = newline ? newline - text + 1 : bytes;
+    }
+
+    std::vector<Dictionary> local_dicts(num_threads);
+    std::vector<std::vector<int>> local_encoded_chunks(num_threads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        if (range_start[t] < range_start[t + 1]) {
+            threads.emplace_back([&, t] {
+                encodeChunk(text + range_start[t], text + range_start[t + 1], local_dicts[t], local_encoded_chunks[t]);
+            });
+        }
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    return mergeEncodedChunks(local_dicts, local_encoded_chunks, sorted_dictionary, posting_lists);
+}
+
+
+// Narrowest byte-aligned width, in bytes, that holds every ID below `cardinality`
+int idBytesFor(size_t cardinality) {
+    return cardinality <= (size_t(1) << 8) ? 1 : cardinality <= (size_t(1) << 16) ? 2 : 4;
+}
+
+// Copy the IDs into narrow_data at the narrowest byte-aligned width the dictionary allows, each thread copying a
+// contiguous run of rows. Leaves narrow_data empty when that width is the full 32 bits.
+void narrowEncodedColumn(EncodedColumn& encoded_column, int num_threads) {
+    int width = idBytesFor(encoded_column.dictionary.size());
+    size_t rows = encoded_column.size();
+    if (width == 4) {
+        encoded_column.narrow_width = 0;
+        std::vector<uint8_t>().swap(encoded_column.narrow_data);
+        return;
+    }
+    encoded_column.narrow_width = width;
+    encoded_column.narrow_data.resize(rows * width);
+
+    size_t rows_per_thread = (rows + num_threads - 1) / std::max(num_threads, 1);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        size_t first = t * rows_per_thread;
+        size_t last = std::min(first + rows_per_thread, rows);
+        if (first < last) {
+            threads.emplace_back([&, first, last] {
+                uint8_t* out = encoded_column.narrow_data.data();
+                for (size_t row = first; row < last; ++row) {
+                    uint16_t id = static_cast<uint16_t>(encoded_column.id(row));
+                    std::memcpy(out + row * width, &id, width);   // little-endian: the low byte first
+                }
+            });
+        }
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Bit-pack encoded_data into packed_data, each thread packing a contiguous run of blocks
+void packEncodedColumn(EncodedColumn& encoded_column, int num_threads) {
+    if (encoded_column.encoded_data.empty()) {
+        return;   // nothing to pack, or a column opened from a file that is packed already
+    }
+    PackedColumn& packed = encoded_column.packed_data;
+    packed.reset(encoded_column.encoded_data.size(), encoded_column.dictionary.size());
+
+    size_t num_blocks = packed.numBlocks();
+    size_t blocks_per_thread = (num_blocks + num_threads - 1) / num_threads;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        size_t first = t * blocks_per_thread;
+        size_t last = std::min(first + blocks_per_thread, num_blocks);
+        if (first < last) {
+            threads.emplace_back([&, first, last] {
+                packed.packBlocks(encoded_column.encoded_data.data(), first, last);
+            });
+        }
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+
+// Predicates for the bit-packed scans. A matcher turns a vector of unpacked IDs (16 with AVX-512, 8 with AVX2)
+// into a bit mask of the matching lanes. matchNarrow<U> does the same on one vector of IDs stored as U, uint8_t
+// or uint16_t: NARROW_VECTOR_BYTES / sizeof(U) rows per compare.
+
+#if defined(__AVX512BW__)
+constexpr size_t NARROW_VECTOR_BYTES = 64;
+#else
+constexpr size_t NARROW_VECTOR_BYTES = 32;
+#endif
+
+// One bit per 16-bit lane from a _mm256_movemask_epi8 mask, which sets both bits of each lane
+inline uint32_t wordLaneMask(uint32_t byte_mask) {
+    uint32_t mask = byte_mask & 0x55555555u;
+    mask = (mask | mask >> 1) & 0x33333333u;
+    mask = (mask | mask >> 2) & 0x0F0F0F0Fu;
+    mask = (mask | mask >> 4) & 0x00FF00FFu;
+    return (mask | mask >> 8) & 0x0000FFFFu;
+}
+
+// lo <= id <= hi, as a single unsigned compare of id - lo against hi - lo; equality is the range [id, id]
+struct IdRangeMatcher {
+    uint32_t lo;
+    uint32_t span;
+
+    // A short range also consults the zone's Bloom filter
+    bool mayMatch(const ColumnZone& zone) const {
+        if (!zone.overlaps(lo, lo + span)) {
+            return false;
+        }
+        if (span >= 8) {
+            return true;
+        }
+        for (uint32_t id = lo; id <= lo + span; ++id) {
+            if (zone.mayContain(id)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+#if defined(__AVX512F__)
+    uint32_t operator()(__m512i ids) const {
+        return _mm512_cmple_epu32_mask(_mm512_sub_epi32(ids, _mm512_set1_epi32(lo)), _mm512_set1_epi32(span));
+    }
+#else
+    uint32_t operator()(__m256i ids) const {
+        __m256i offset = _mm256_sub_epi32(ids, _mm256_set1_epi32(lo));
+        __m256i in_range = _mm256_cmpeq_epi32(_mm256_min_epu32(offset, _mm256_set1_epi32(span)), offset);
+        return _mm256_movemask_ps(_mm256_castsi256_ps(in_range));
+    }
+#endif
+
+    // lo and span fit in U, as every ID of a narrow column does
+    template <typename U>
+    uint64_t matchNarrow(const U* ids) const {
+#if defined(__AVX512BW__)
+        __m512i values = _mm512_loadu_si512(ids);
+        if constexpr (sizeof(U) == 1) {
+            return _mm512_cmple_epu8_mask(_mm512_sub_epi8(values, _mm512_set1_epi8(static_cast<char>(lo))),
+                                          _mm512_set1_epi8(static_cast<char>(span)));
+        } else {
+            return _mm512_cmple_epu16_mask(_mm512_sub_epi16(values, _mm512_set1_epi16(static_cast<short>(lo))),
+                                           _mm512_set1_epi16(static_cast<short>(span)));
+        }
+#else
+        __m256i values = _mm256_loadu_si256((const __m256i*)ids);
+        if constexpr (sizeof(U) == 1) {
+            __m256i offset = _mm256_sub_epi8(values, _mm256_set1_epi8(static_cast<char>(lo)));
+            __m256i in_range = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, _mm256_set1_epi8(static_cast<char>(span))), offset);
+            return static_cast<uint32_t>(_mm256_movemask_epi8(in_range));
+        } else {
+            __m256i offset = _mm256_sub_epi16(values, _mm256_set1_epi16(static_cast<short>(lo)));
+            __m256i in_range = _mm256_cmpeq_epi16(_mm256_min_epu16(offset, _mm256_set1_epi16(static_cast<short>(span))), offset);
+            return wordLaneMask(_mm256_movemask_epi8(in_range));
+        }
+#endif
+    }
+};
+
+// id is one of a short IN-list, one compare per listed ID
+struct IdListMatcher {
+    static constexpr int MAX_IDS = 8;
+    uint32_t ids[MAX_IDS];
+    int num_ids = 0;
+
+    bool mayMatch(const ColumnZone& zone) const {
+        for (int i = 0; i < num_ids; ++i) {
+            if (zone.mayContain(ids[i])) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+#if defined(__AVX512F__)
+    uint32_t operator()(__m512i values) const {
+        __mmask16 mask = 0;
+        for (int i = 0; i < num_ids; ++i) {
+            mask |= _mm512_cmpeq_epi32_mask(values, _mm512_set1_epi32(ids[i]));
+        }
+        return mask;
+    }
+#else
+    uint32_t operator()(__m256i values) const {
+        __m256i match = _mm256_setzero_si256();
+        for (int i = 0; i < num_ids; ++i) {
+            match = _mm256_or_si256(match, _mm256_cmpeq_epi32(values, _mm256_set1_epi32(ids[i])));
+        }
+        return _mm256_movemask_ps(_mm256_castsi256_ps(match));
+    }
+#endif
+
+    template <typename U>
+    uint64_t matchNarrow(const U* values) const {
+#if defined(__AVX512BW__)
+        __m512i narrow = _mm512_loadu_si512(values);
+        uint64_t mask = 0;
+        for (int i = 0; i < num_ids; ++i) {
+            if constexpr (sizeof(U) == 1) {
+                mask |= _mm512_cmpeq_epi8_mask(narrow, _mm512_set1_epi8(static_cast<char>(ids[i])));
+            } else {
+                mask |= _mm512_cmpeq_epi16_mask(narrow, _mm512_set1_epi16(static_cast<short>(ids[i])));
+            }
+        }
+        return mask;
+#else
+        __m256i narrow = _mm256_loadu_si256((const __m256i*)values);
+        __m256i match = _mm256_setzero_si256();
+        for (int i = 0; i < num_ids; ++i) {
+            if constexpr (sizeof(U) == 1) {
+                match = _mm256_or_si256(match, _mm256_cmpeq_epi8(narrow, _mm256_set1_epi8(static_cast<char>(ids[i]))));
+            } else {
+                match = _mm256_or_si256(match, _mm256_cmpeq_epi16(narrow, _mm256_set1_epi16(static_cast<short>(ids[i]))));
+            }
+        }
+        uint32_t byte_mask = _mm256_movemask_epi8(match);
+        return sizeof(U) == 1 ? byte_mask : wordLaneMask(byte_mask);
+#endif
+    }
+};
+
+// id is set in a bitmap over the dictionary IDs; each lane gathers its bitmap word and tests its bit
+struct IdSetMatcher {
+    const uint32_t* bitmap;
+    uint32_t min_id;   // the smallest and largest ID set in the bitmap
+    uint32_t max_id;
+
+    bool mayMatch(const ColumnZone& zone) const { return zone.overlaps(min_id, max_id); }
+
+#if defined(__AVX512F__)
+    uint32_t operator()(__m512i ids) const {
+        __m512i word_index = _mm512_maskz_srli_epi32(0xFFFF, ids, 5);
+        __m512i words = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xFFFF, word_index, bitmap, 4);
+        __m512i bit = _mm512_maskz_sllv_epi32(0xFFFF, _mm512_set1_epi32(1), _mm512_and_si512(ids, _mm512_set1_epi32(31)));
+        return _mm512_test_epi32_mask(words, bit);
+    }
+#else
+    uint32_t operator()(__m256i ids) const {
+        __m256i words = _mm256_i32gather_epi32(reinterpret_cast<const int*>(bitmap), _mm256_srli_epi32(ids, 5), 4);
+        __m256i bit = _mm256_sllv_epi32(_mm256_set1_epi32(1), _mm256_and_si256(ids, _mm256_set1_epi32(31)));
+        __m256i clear = _mm256_cmpeq_epi32(_mm256_and_si256(words, bit), _mm256_setzero_si256());
+        return ~_mm256_movemask_ps(_mm256_castsi256_ps(clear)) & 0xFF;
+    }
+#endif
+
+    // The gather needs 32-bit indices, so the narrow IDs are widened a vector at a time (with the all-lanes
+    // maskz widening forms, which GCC 12 does not flag with -Wmaybe-uninitialized)
+    template <typename U>
+    uint64_t matchNarrow(const U* ids) const {
+        uint64_t mask = 0;
+#if defined(__AVX512F__)
+        for (size_t i = 0; i < NARROW_VECTOR_BYTES / sizeof(U); i += 16) {
+            __m512i wide = sizeof(U) == 1
+                ? _mm512_maskz_cvtepu8_epi32(0xFFFF, _mm_loadu_si128((const __m128i*)(ids + i)))
+                : _mm512_maskz_cvtepu16_epi32(0xFFFF, _mm256_loadu_si256((const __m256i*)(ids + i)));
+            mask |= uint64_t((*this)(wide)) << i;
+        }
+#else
+        for (size_t i = 0; i < NARROW_VECTOR_BYTES / sizeof(U); i += 8) {
+            __m256i wide = sizeof(U) == 1 ? _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(ids + i)))
+                                          : _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(ids + i)));
+            mask |= uint64_t((*this)(wide)) << i;
+        }
+#endif
+        return mask;
+    }
+};
+
+// Unpack one block at the compile-time width BITS and store the 16-row match mask of each of its 32 row groups.
+// The loop over the groups is fully unrolled, so every shift is an immediate. (The AVX-512 shifts use their
+// all-lanes maskz forms, which GCC 12 does not flag with -Wmaybe-uninitialized.)
+template <int BITS, typename Matcher>
+void matchPackedBlock(const uint32_t* in, const Matcher& block_matcher, uint32_t* masks) {
+    constexpr size_t LANES = PackedColumn::LANES;
+    const uint32_t value_mask = BITS == 32 ? 0xFFFFFFFFu : (1u << BITS) - 1;
+    const Matcher matcher = block_matcher;   // a local copy, so the mask stores cannot alias its constants
+
+#pragma GCC unroll 32
+    for (int k = 0; k < 32; ++k) {
+        const int word = k * BITS / 32;
+        const int shift = k * BITS % 32;
+        const bool straddles = shift + BITS > 32;
+
+#if defined(__AVX512F__)
+        __m512i ids = _mm512_maskz_srli_epi32(0xFFFF, _mm512_loadu_si512(in + word * LANES), shift);
+        if (straddles) {
+            __m512i next = _mm512_loadu_si512(in + (word + 1) * LANES);
+            ids = _mm512_or_si512(ids, _mm512_maskz_slli_epi32(0xFFFF, next, 32 - shift));
+        }
+        if (BITS < 32) {
+            ids = _mm512_and_si512(ids, _mm512_set1_epi32(value_mask));
+        }
+        masks[k] = matcher(ids);
+#else
+        uint32_t mask = 0;
+        for (int half = 0; half < 2; ++half) {
+            const uint32_t* lanes = in + half * 8;
+            __m256i ids = _mm256_srli_epi32(_mm256_loadu_si256((const __m256i*)(lanes + word * LANES)), shift);
+            if (straddles) {
+                __m256i next = _mm256_loadu_si256((const __m256i*)(lanes + (word + 1) * LANES));
+                ids = _mm256_or_si256(ids, _mm256_slli_epi32(next, 32 - shift));
+            }
+            if (BITS < 32) {
+                ids = _mm256_and_si256(ids, _mm256_set1_epi32(value_mask));
+            }
+            mask |= matcher(ids) << (half * 8);
+        }
+        masks[k] = mask;
+#endif
+    }
+}
+
+template <typename Matcher>
+using BlockMatchKernel = void (*)(const uint32_t*, const Matcher&, uint32_t*);
+
+// matchPackedBlock for every width 1..32, indexed by width - 1
+template <typename Matcher, int... WIDTHS>
+constexpr std::array<BlockMatchKernel<Matcher>, 32> blockMatchKernels(std::integer_sequence<int, WIDTHS...>) {
+    return {&matchPackedBlock<WIDTHS + 1, Matcher>...};
+}
+
+// Unpack one block at the compile-time width BITS into its 512 IDs, in row order
+template <int BITS>
+void unpackPackedBlock(const uint32_t* in, int* out) {
+    constexpr size_t LANES = PackedColumn::LANES;
+    const uint32_t value_mask = BITS == 32 ? 0xFFFFFFFFu : (1u << BITS) - 1;
+
+#pragma GCC unroll 32
+    for (int k = 0; k < 32; ++k) {
+        const int word = k * BITS / 32;
+        const int shift = k * BITS % 32;
+        const bool straddles = shift + BITS > 32;
+
+#if defined(__AVX512F__)
+        __m512i ids = _mm512_maskz_srli_epi32(0xFFFF, _mm512_loadu_si512(in + word * LANES), shift);
+        if (straddles) {
+            __m512i next = _mm512_loadu_si512(in + (word + 1) * LANES);
+            ids = _mm512_or_si512(ids, _mm512_maskz_slli_epi32(0xFFFF, next, 32 - shift));
+        }
+        _mm512_storeu_si512(out + k * LANES, _mm512_and_si512(ids, _mm512_set1_epi32(value_mask)));
+#else
+        for (int half = 0; half < 2; ++half) {
+            const uint32_t* lanes = in + half * 8;
+            __m256i ids = _mm256_srli_epi32(_mm256_loadu_si256((const __m256i*)(lanes + word * LANES)), shift);
+            if (straddles) {
+                __m256i next = _mm256_loadu_si256((const __m256i*)(lanes + (word + 1) * LANES));
+                ids = _mm256_or_si256(ids, _mm256_slli_epi32(next, 32 - shift));
+            }
+            _mm256_storeu_si256((__m256i*)(out + k * LANES + half * 8), _mm256_and_si256(ids, _mm256_set1_epi32(value_mask)));
+        }
+#endif
+    }
+}
+
+using BlockUnpackKernel = void (*)(const uint32_t*, int*);
+
+// unpackPackedBlock for every width 1..32, indexed by width - 1
+template <int... WIDTHS>
+constexpr std::array<BlockUnpackKernel, 32> blockUnpackKernels(std::integer_sequence<int, WIDTHS...>) {
+    return {&unpackPackedBlock<WIDTHS + 1>...};
+}
+
+// The 512 IDs of block `block` of `column` (padding rows past the end unpack as ID 0)
+void unpackBlock(const PackedColumn& column, size_t block, int* out) {
+    static constexpr std::array<BlockUnpackKernel, 32> kernels =
+        blockUnpackKernels(std::make_integer_sequence<int, 32>());
+    kernels[column.bitWidth() - 1](column.blockWords(block), out);
+}
+
+// Scan blocks [first_block, last_block) of `column` (by default all of them) with the kernel for its bit width
+// and call emit(mask, first_row) for each run of 16 rows with at least one match. Emitting sits outside the
+// per-width kernels, so each (width, matcher) pair is compiled once whatever the output format. Padding rows
+// past the end of the column never match.
+template <typename Matcher, typename Emit>
+void scanPacked(const PackedColumn& column, const Matcher& matcher, Emit& emit,
+                size_t first_block = 0, size_t last_block = SIZE_MAX) {
+    static constexpr std::array<BlockMatchKernel<Matcher>, 32> kernels =
+        blockMatchKernels<Matcher>(std::make_integer_sequence<int, 32>());
+    BlockMatchKernel<Matcher> kernel = kernels[column.bitWidth() - 1];
+    size_t count = column.size();
+    uint32_t masks[32];
+
+    last_block = std::min(last_block, column.numBlocks());
+    for (size_t block = first_block; block < last_block; ++block) {
+        kernel(column.blockWords(block), matcher, masks);
+        size_t block_start = block * PackedColumn::BLOCK_ROWS;
+        for (int k = 0; k < 32; ++k) {
+            uint32_t mask = masks[k];
+            size_t first_row = block_start + k * PackedColumn::LANES;
+            if (first_row + PackedColumn::LANES > count) {
+                mask &= first_row >= count ? 0 : (1u << (count - first_row)) - 1;
+            }
+            if (mask) {
+                emit(mask, first_row);
+            }
+        }
+    }
+}
+
+// The same matchers over rows [begin_row, count) of the unpacked 32-bit IDs in `data`, 16 rows per step;
+// begin_row must be a multiple of 16. The last partial step runs on a zero-padded copy and masks off the padding.
+template <typename Matcher, typename Emit>
+void scanUnpacked(const int* data, size_t count, const Matcher& matcher, Emit& emit, size_t begin_row = 0) {
+    alignas(64) int tail[16] = {0};
+    for (size_t first_row = begin_row; first_row < count; first_row += 16) {
+        const int* ids = data + first_row;
+        bool partial = first_row + 16 > count;
+        if (partial) {
+            std::memcpy(tail, ids, (count - first_row) * sizeof(int));
+            ids = tail;
+        }
+
+#if defined(__AVX512F__)
+        uint32_t mask = matcher(_mm512_loadu_si512(ids));
+#else
+        uint32_t mask = matcher(_mm256_loadu_si256((const __m256i*)ids)) |
+                        matcher(_mm256_loadu_si256((const __m256i*)(ids + 8))) << 8;
+#endif
+
+        if (partial) {
+            mask &= (1u << (count - first_row)) - 1;
+        }
+        if (mask) {
+            emit(mask, first_row);
+        }
+    }
+}
+
+// The matchers over rows [begin_row, count) of IDs stored as U (uint8_t or uint16_t), one vector of
+// NARROW_VECTOR_BYTES / sizeof(U) rows per compare; begin_row must be a multiple of that. Each vector's match
+// mask is emitted in 16-row groups like the other scans. The last partial vector runs on a zero-padded copy.
+template <typename U, typename Matcher, typename Emit>
+void scanNarrow(const U* data, size_t count, const Matcher& matcher, Emit& emit, size_t begin_row = 0) {
+    constexpr size_t STEP = NARROW_VECTOR_BYTES / sizeof(U);
+    alignas(64) U tail[STEP];
+    for (size_t first_row = begin_row; first_row < count; first_row += STEP) {
+        const U* ids = data + first_row;
+        bool partial = first_row + STEP > count;
+        if (partial) {
+            std::memset(tail, 0, sizeof(tail));
+            std::memcpy(tail, ids, (count - first_row) * sizeof(U));
+            ids = tail;
+        }
+
+        uint64_t mask = matcher.template matchNarrow<U>(ids);
+        if (partial) {
+            mask &= (uint64_t(1) << (count - first_row)) - 1;
+        }
+        while (mask) {
+            int group = __builtin_ctzll(mask) & ~15;
+            emit(static_cast<uint32_t>(mask >> group) & 0xFFFF, first_row + group);
+            mask &= ~(uint64_t(0xFFFF) << group);
+        }
+    }
+}
+
+// Scan the narrowest copy of the IDs there is: the byte-aligned IDs once narrowEncodedColumn has run, which are
+// compared without unpacking, else the bit-packed copy once packEncodedColumn has run, otherwise the 32-bit
+// IDs. Either way only the rows of blocks [first_block, last_block) are scanned, with blocks of
+// PackedColumn::BLOCK_ROWS rows.
+template <typename Matcher, typename Emit>
+void scanIdBlocks(const EncodedColumn& encoded_column, const Matcher& matcher, Emit& emit,
+                  size_t first_block, size_t last_block) {
+    if (encoded_column.hasNarrowData()) {
+        size_t end_row = std::min(last_block * PackedColumn::BLOCK_ROWS, encoded_column.size());
+        const uint8_t* data = encoded_column.narrow_data.data();
+        if (encoded_column.narrow_width == 1) {
+            scanNarrow(data, end_row, matcher, emit, first_block * PackedColumn::BLOCK_ROWS);
+        } else {
+            scanNarrow(reinterpret_cast<const uint16_t*>(data), end_row, matcher, emit, first_block * PackedColumn::BLOCK_ROWS);
+        }
+    } else if (encoded_column.hasPackedData()) {
+        scanPacked(encoded_column.packed_data, matcher, emit, first_block, last_block);
+    } else {
+        const std::vector<int>& data = encoded_column.encoded_data;
+        size_t end_row = last_block == SIZE_MAX ? data.size() : std::min(last_block * PackedColumn::BLOCK_ROWS, data.size());
+        scanUnpacked(data.data(), end_row, matcher, emit, first_block * PackedColumn::BLOCK_ROWS);
+    }
+}
+
+// scanIdBlocks, skipping every zone the zone map rules out for `matcher`
+template <typename Matcher, typename Emit>
+void scanIds(const EncodedColumn& encoded_column, const Matcher& matcher, Emit& emit,
+             size_t first_block = 0, size_t last_block = SIZE_MAX) {
+    constexpr size_t ZONE_BLOCKS = EncodedColumn::ZONE_ROWS / PackedColumn::BLOCK_ROWS;
+    last_block = std::min(last_block, (encoded_column.size() + PackedColumn::BLOCK_ROWS - 1) / PackedColumn::BLOCK_ROWS);
+    const std::vector<ColumnZone>& zones = encoded_column.zones;
+    for (size_t block = first_block; block < last_block;) {
+        size_t zone = block / ZONE_BLOCKS;
+        size_t zone_end = std::min((zone + 1) * ZONE_BLOCKS, last_block);
+        if (zone >= zones.size() || matcher.mayMatch(zones[zone])) {
+            scanIdBlocks(encoded_column, matcher, emit, block, zone_end);
+        }
+        block = zone_end;
+    }
+}
+
+// Scan output as a selection vector: the matching row numbers in ascending order
+struct SelectionCollector {
+    std::vector<int> indices;
+
+    void operator()(uint32_t mask, size_t first_row) {
+        while (mask) {
+            indices.push_back(static_cast<int>(first_row + __builtin_ctz(mask)));
+            mask &= mask - 1;
+        }
+    }
+};
+
+// Scan output as a bitmap with one bit per row. The scans emit 16-row groups starting at multiples of 16,
+// so each mask lands inside a single word.
+struct BitmapCollector {
+    std::vector<uint64_t> words;
+
+    explicit BitmapCollector(size_t rows) : words((rows + 63) / 64, 0) {}
+
+    void operator()(uint32_t mask, size_t first_row) {
+        words[first_row / 64] |= uint64_t(mask) << (first_row % 64);
+    }
+};
+
+// A set of row numbers laid out like a Roaring bitmap. Rows are split into chunks of 65,536, and each non-empty
+// chunk keeps the low 16 bits of its rows in whichever container is smallest: a sorted array (up to 4096 rows),
+// a bitmap of 1024 words, or a list of runs. AND, OR and NOT work chunk by chunk on bitmaps and compress the
+// result again. Iterating decodes one row at a time, so nothing is materialised unless asked for.
+class RowSet {
+public:
+    static constexpr size_t CHUNK_ROWS = size_t(1) << 16;
+    static constexpr size_t CHUNK_WORDS = CHUNK_ROWS / 64;
+
+private:
+    struct Container {
+        enum Kind { ARRAY, BITMAP, RUNS };
+        Kind kind = ARRAY;
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> values;   // ARRAY: the rows; RUNS: a start, length - 1 pair per run
+        std::vector<uint64_t> words;    // BITMAP
+    };
+
+    std::vector<uint32_t> keys;   // chunk numbers, ascending
+    std::vector<Container> containers;
+    size_t num_rows = 0;          // rows of the column, which bound complement()
+
+    // Set bits [first, last] of a chunk bitmap
+    static void fillRange(uint64_t* words, uint32_t first, uint32_t last) {
+        for (uint32_t word = first / 64; word <= last / 64; ++word) {
+            uint64_t mask = ~uint64_t(0);
+            if (word == first / 64) {
+                mask &= ~uint64_t(0) << (first % 64);
+            }
+            if (word == last / 64) {
+                mask &= ~uint64_t(0) >> (63 - last % 64);
+            }
+            words[word] |= mask;
+        }
+    }
+
+    // The smallest container for a chunk bitmap; false if the chunk is empty
+    static bool compress(const uint64_t* words, Container& out) {
+        uint32_t cardinality = 0;
+        uint32_t runs = 0;
+        uint64_t carry = 0;
+        for (size_t i = 0; i < CHUNK_WORDS; ++i) {
+            cardinality += __builtin_popcountll(words[i]);
+            runs += __builtin_popcountll(words[i] & ~(words[i] << 1 | carry));
+            carry = words[i] >> 63;
+        }
+        if (cardinality == 0) {
+            return false;
+        }
+        out.cardinality = cardinality;
+
+        size_t array_bytes = cardinality * sizeof(uint16_t);
+        size_t run_bytes = runs * 2 * sizeof(uint16_t);
+        size_t bitmap_bytes = CHUNK_WORDS * sizeof(uint64_t);
+        if (run_bytes < array_bytes && run_bytes < bitmap_bytes) {
+            // A run starts at a set bit after a clear one and ends at a set bit before a clear one
+            out.kind = Container::RUNS;
+            out.values.resize(2 * runs);
+            size_t started = 0;
+            size_t ended = 0;
+            carry = 0;
+            for (size_t i = 0; i < CHUNK_WORDS; ++i) {
+                uint64_t next = i + 1 < CHUNK_WORDS ? words[i + 1] & 1 : 0;
+                uint64_t run_starts = words[i] & ~(words[i] << 1 | carry);
+                uint64_t run_ends = words[i] & ~(words[i] >> 1 | next << 63);
+                carry = words[i] >> 63;
+                for (; run_starts; run_starts &= run_starts - 1) {
+                    out.values[2 * started++] = static_cast<uint16_t>(i * 64 + __builtin_ctzll(run_starts));
+                }
+                for (; run_ends; run_ends &= run_ends - 1) {
+                    uint32_t end = static_cast<uint32_t>(i * 64 + __builtin_ctzll(run_ends));
+                    out.values[2 * ended + 1] = static_cast<uint16_t>(end - out.values[2 * ended]);
+                    ++ended;
+                }
+            }
+        } else if (array_bytes <= bitmap_bytes) {
+            out.kind = Container::ARRAY;
+            out.values.reserve(cardinality);
+            for (size_t i = 0; i < CHUNK_WORDS; ++i) {
+                for (uint64_t word = words[i]; word; word &= word - 1) {
+                    out.values.push_back(static_cast<uint16_t>(i * 64 + __builtin_ctzll(word)));
+                }
+            }
+        } else {
+            out.kind = Container::BITMAP;
+            out.words.assign(words, words + CHUNK_WORDS);
+        }
+        return true;
+    }
+
+    // OR the container into the chunk bitmap `words`
+    static void expand(const Container& container, uint64_t* words) {
+        switch (container.kind) {
+            case Container::ARRAY:
+                for (uint16_t row : container.values) {
+                    words[row / 64] |= uint64_t(1) << (row % 64);
+                }
+                break;
+            case Container::RUNS:
+                for (size_t i = 0; i < container.values.size(); i += 2) {
+                    fillRange(words, container.values[i], container.values[i] + container.values[i + 1]);
+                }
+                break;
+            case Container::BITMAP:
+                for (size_t i = 0; i < CHUNK_WORDS; ++i) {
+                    words[i] |= container.words[i];
+                }
+                break;
+        }
+    }
+
+    // Combine two sets chunk by chunk. combine(a, b, out) gets the bitmaps of one chunk, zero where a set has no
+    // container for it, and writes the result chunk to `out`. Only chunks held by either set are visited.
+    template <typename Combine>
+    static RowSet merge(const RowSet& a, const RowSet& b, const Combine& combine) {
+        RowSet result(std::max(a.num_rows, b.num_rows));
+        std::vector<uint64_t> words_a(CHUNK_WORDS);
+        std::vector<uint64_t> words_b(CHUNK_WORDS);
+        std::vector<uint64_t> words_out(CHUNK_WORDS);
+        size_t i = 0;
+        size_t j = 0;
+        while (i < a.keys.size() || j < b.keys.size()) {
+            uint32_t key = i == a.keys.size() ? b.keys[j]
+                           : j == b.keys.size() ? a.keys[i] : std::min(a.keys[i], b.keys[j]);
+            std::fill(words_a.begin(), words_a.end(), 0);
+            std::fill(words_b.begin(), words_b.end(), 0);
+            if (i < a.keys.size() && a.keys[i] == key) {
+                expand(a.containers[i++], words_a.data());
+            }
+            if (j < b.keys.size() && b.keys[j] == key) {
+                expand(b.containers[j++], words_b.data());
+            }
+            combine(words_a.data(), words_b.data(), words_out.data());
+            result.appendChunk(key, words_out.data());
+        }
+        return result;
+    }
+
+public:
+    explicit RowSet(size_t rows = 0) : num_rows(rows) {}
+
+    size_t universe() const { return num_rows; }
+
+    // Rows in the set
+    size_t size() const {
+        size_t count = 0;
+        for (const Container& container : containers) {
+            count += container.cardinality;
+        }
+        return count;
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = keys.capacity() * sizeof(uint32_t) + containers.capacity() * sizeof(Container);
+        for (const Container& container : containers) {
+            bytes += container.values.capacity() * sizeof(uint16_t) + container.words.capacity() * sizeof(uint64_t);
+        }
+        return bytes;
+    }
+
+    // Append the rows set in the chunk bitmap `words` as chunk `key`, which must follow every chunk already held
+    void appendChunk(uint32_t key, const uint64_t* words) {
+        Container container;
+        if (compress(words, container)) {
+            keys.push_back(key);
+            containers.push_back(std::move(container));
+        }
+    }
+
+    bool contains(size_t row) const {
+        auto key = std::lower_bound(keys.begin(), keys.end(), static_cast<uint32_t>(row / CHUNK_ROWS));
+        if (key == keys.end() || *key != row / CHUNK_ROWS) {
+            return false;
+        }
+        const Container& container = containers[key - keys.begin()];
+        uint32_t low = static_cast<uint32_t>(row % CHUNK_ROWS);
+        switch (container.kind) {
+            case Container::ARRAY:
+                return std::binary_search(container.values.begin(), container.values.end(), low);
+            case Container::BITMAP:
+                return container.words[low / 64] >> (low % 64) & 1;
+            case Container::RUNS:
+                for (size_t i = 0; i < container.values.size() && container.values[i] <= low; i += 2) {
+                    if (low <= uint32_t(container.values[i]) + container.values[i + 1]) {
+                        return true;
+                    }
+                }
+                return false;
+        }
+        return false;
+    }
+
+    RowSet intersectWith(const RowSet& other) const {
+        return merge(*this, other, [](const uint64_t* a, const uint64_t* b, uint64_t* out) {
+            for (size_t i = 0; i < CHUNK_WORDS; ++i) {
+                out[i] = a[i] & b[i];
+            }
+        });
+    }
+
+    RowSet unionWith(const RowSet& other) const {
+        return merge(*this, other, [](const uint64_t* a, const uint64_t* b, uint64_t* out) {
+            for (size_t i = 0; i < CHUNK_WORDS; ++i) {
+                out[i] = a[i] | b[i];
+            }
+        });
+    }
+
+    // Every row of the column not in the set
+    RowSet complement() const {
+        RowSet result(num_rows);
+        std::vector<uint64_t> words(CHUNK_WORDS);
+        size_t next = 0;
+        for (size_t key = 0; key * CHUNK_ROWS < num_rows; ++key) {
+            std::fill(words.begin(), words.end(), 0);
+            if (next < keys.size() && keys[next] == key) {
+                expand(containers[next++], words.data());
+            }
+            for (size_t i = 0; i < CHUNK_WORDS; ++i) {
+                size_t first_row = key * CHUNK_ROWS + i * 64;
+                uint64_t in_column = first_row >= num_rows ? 0
+                                     : num_rows - first_row >= 64 ? ~uint64_t(0)
+                                                                  : (uint64_t(1) << (num_rows - first_row)) - 1;
+                words[i] = ~words[i] & in_column;
+            }
+            result.appendChunk(static_cast<uint32_t>(key), words.data());
         }
+        return result;
     }
 
-    // Wait for all threads to complete
-    for (auto& thread : threads) {
-        thread.join();
-    }
+    // Forward iterator over the rows in ascending order, decoding one row per step
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = size_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const size_t*;
+        using reference = size_t;
+
+        size_t operator*() const { return row; }
+        Iterator& operator++() {
+            advance();
+            return *this;
+        }
+        bool operator==(const Iterator& other) const { return container == other.container && row == other.row; }
+        bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class RowSet;
+
+        const RowSet* set;
+        size_t container;
+        size_t position = 0;     // ARRAY: index; RUNS: run; BITMAP: word
+        uint32_t run_offset = 0;
+        uint64_t word = 0;       // BITMAP: the bits of the current word not visited yet
+        size_t row = 0;
+
+        Iterator(const RowSet* row_set, size_t first_container) : set(row_set), container(first_container) { load(); }
+
+        // Settle on the first row of `container`, or become the end iterator
+        void load() {
+            position = 0;
+            run_offset = 0;
+            if (container == set->containers.size()) {
+                row = 0;
+                return;
+            }
+            const Container& current = set->containers[container];
+            size_t base = size_t(set->keys[container]) * CHUNK_ROWS;
+            if (current.kind == Container::BITMAP) {
+                while (current.words[position] == 0) {
+                    ++position;
+                }
+                word = current.words[position];
+                row = base + position * 64 + __builtin_ctzll(word);
+            } else {
+                row = base + current.values[0];
+            }
+        }
+
+        void advance() {
+            const Container& current = set->containers[container];
+            size_t base = size_t(set->keys[container]) * CHUNK_ROWS;
+            switch (current.kind) {
+                case Container::ARRAY:
+                    if (++position < current.values.size()) {
+                        row = base + current.values[position];
+                        return;
+                    }
+                    break;
+                case Container::RUNS:
+                    if (run_offset < current.values[2 * position + 1]) {
+                        row = base + current.values[2 * position] + ++run_offset;
+                        return;
+                    }
+                    if (++position < current.values.size() / 2) {
+                        run_offset = 0;
+                        row = base + current.values[2 * position];
+                        return;
+                    }
+                    break;
+                case Container::BITMAP:
+                    word &= word - 1;
+                    while (word == 0 && ++position < CHUNK_WORDS) {
+                        word = current.words[position];
+                    }
+                    if (word) {
+                        row = base + position * 64 + __builtin_ctzll(word);
+                        return;
+                    }
+                    break;
+            }
+            ++container;
+            load();
+        }
+    };
+
+    Iterator begin() const { return Iterator(this, 0); }
+    Iterator end() const { return Iterator(this, containers.size()); }
+
+    // The rows as a selection vector
+    std::vector<int> toVector() const {
+        std::vector<int> rows;
+        rows.reserve(size());
+        for (size_t row : *this) {
+            rows.push_back(static_cast<int>(row));
+        }
+        return rows;
+    }
+};
+
+// Scan output as a RowSet, built from the 16-row masks one chunk bitmap at a time. The scans emit rows in
+// ascending order, so each chunk is compressed as soon as the scan moves past it.
+class RowSetCollector {
+    RowSet rows;
+    std::vector<uint64_t> words;
+    uint32_t chunk = UINT32_MAX;
+
+    void flush() {
+        if (chunk != UINT32_MAX) {
+            rows.appendChunk(chunk, words.data());
+            std::fill(words.begin(), words.end(), 0);
+        }
+    }
+
+public:
+    explicit RowSetCollector(size_t num_rows) : rows(num_rows), words(RowSet::CHUNK_WORDS, 0) {}
+
+    void operator()(uint32_t mask, size_t first_row) {
+        uint32_t key = static_cast<uint32_t>(first_row / RowSet::CHUNK_ROWS);
+        if (key != chunk) {
+            flush();
+            chunk = key;
+        }
+        size_t offset = first_row % RowSet::CHUNK_ROWS;
+        words[offset / 64] |= uint64_t(mask) << (offset % 64);
+    }
+
+    // The collected rows; call once, after the scan
+    RowSet finish() {
+        flush();
+        chunk = UINT32_MAX;
+        return std::move(rows);
+    }
+};
+
+// The cheapest matcher for the ID set `ids` (IDs outside the dictionary are ignored): one range compare when the
+// IDs are contiguous, a compare per ID for up to 8 IDs, and otherwise a bitmap over the dictionary tested by
+// gather. Built once, it can drive any number of scans.
+class IdSetFilter {
+    enum Kind { EMPTY, RANGE, LIST, BITMAP };
+    Kind kind = EMPTY;
+    IdRangeMatcher range{0, 0};   // for BITMAP, the span of its IDs
+    IdListMatcher list;
+    std::vector<uint32_t> bitmap;
+
+public:
+    IdSetFilter(std::vector<int> ids, size_t cardinality) {
+        ids.erase(std::remove_if(ids.begin(), ids.end(),
+                                 [&](int id) { return id < 0 || static_cast<size_t>(id) >= cardinality; }),
+                  ids.end());
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        if (ids.empty()) {
+            return;
+        }
+
+        if (static_cast<size_t>(ids.back() - ids.front()) + 1 == ids.size()) {
+            kind = RANGE;
+            range = {static_cast<uint32_t>(ids.front()), static_cast<uint32_t>(ids.back() - ids.front())};
+        } else if (ids.size() <= IdListMatcher::MAX_IDS) {
+            kind = LIST;
+            for (int id : ids) {
+                list.ids[list.num_ids++] = id;
+            }
+        } else {
+            // Covers every value an ID of the column's packed width can hold, so a corrupt mapped file cannot
+            // make the gather read past the bitmap
+            kind = BITMAP;
+            range = {static_cast<uint32_t>(ids.front()), static_cast<uint32_t>(ids.back() - ids.front())};
+            bitmap.assign((size_t(1) << PackedColumn::bitWidthFor(cardinality)) / 32 + 1, 0);
+            for (int id : ids) {
+                bitmap[id / 32] |= 1u << (id % 32);
+            }
+        }
+    }
+
+    bool empty() const { return kind == EMPTY; }
+
+    // False only if no row of `zone` can match
+    bool mayMatch(const ColumnZone& zone) const {
+        bool may_match = false;
+        visit([&](const auto& matcher) { may_match = matcher.mayMatch(zone); });
+        return may_match;
+    }
+
+    // Call scan(matcher) with the matcher; returns false without scanning when no ID is valid
+    template <typename Scan>
+    bool visit(const Scan& scan) const {
+        switch (kind) {
+            case RANGE: scan(range); return true;
+            case LIST: scan(list); return true;
+            case BITMAP: scan(IdSetMatcher{bitmap.data(), range.lo, range.lo + range.span}); return true;
+            default: return false;
+        }
+    }
+};
+
+// Call scan(matcher) once with the cheapest matcher for `ids`, as built by IdSetFilter. Returns false without
+// scanning when no ID is valid.
+template <typename Scan>
+bool withIdSetMatcher(std::vector<int> ids, size_t cardinality, const Scan& scan) {
+    return IdSetFilter(std::move(ids), cardinality).visit(scan);
+}
+
+// Rows whose ID lies in [lo_id, hi_id], scanned straight from the bit-packed column
+std::vector<int> packedRangeScan(const PackedColumn& column, uint32_t lo_id, uint32_t hi_id) {
+    SelectionCollector selection;
+    if (lo_id <= hi_id) {
+        scanPacked(column, IdRangeMatcher{lo_id, hi_id - lo_id}, selection);
+    }
+    return std::move(selection.indices);
+}
+
+// Rows whose ID is any of `ids`, scanned straight from the bit-packed column
+std::vector<int> packedInScan(const PackedColumn& column, const std::vector<int>& ids, size_t cardinality) {
+    SelectionCollector selection;
+    withIdSetMatcher(ids, cardinality, [&](const auto& matcher) { scanPacked(column, matcher, selection); });
+    return std::move(selection.indices);
+}
+
+// simdQuery over the bit-packed column
+std::vector<int> packedQuery(const EncodedColumn& encoded_column, const std::string& query) {
+    int query_id = encoded_column.dictionary.find(query);
+    if (query_id < 0) {
+        return {};
+    }
+    return packedRangeScan(encoded_column.packed_data, query_id, query_id);
+}
+
+// Rows equal to any of `values`, over the bit-packed column
+std::vector<int> packedInQuery(const EncodedColumn& encoded_column, const std::vector<std::string>& values) {
+    std::vector<int> ids;
+    for (const std::string& value : values) {
+        int id = encoded_column.dictionary.find(value);
+        if (id >= 0) {
+            ids.push_back(id);
+        }
+    }
+    return packedInScan(encoded_column.packed_data, ids, encoded_column.dictionary.size());
+}
+
+
+// Rows whose ID lies in [first_id, last_id), in one pass over the column
+std::vector<int> idRangeScan(const EncodedColumn& encoded_column, int first_id, int last_id) {
+    SelectionCollector selection;
+    if (first_id < last_id) {
+        IdRangeMatcher range{static_cast<uint32_t>(first_id), static_cast<uint32_t>(last_id - first_id - 1)};
+        scanIds(encoded_column, range, selection);
+    }
+    return std::move(selection.indices);
+}
+
+// Emit the rows whose ID is any of `ids` as 16-row masks, ascending: from the posting lists in O(matches) when
+// the column has them, otherwise in one pass over the column however many IDs there are
+template <typename Emit>
+void findIdRows(const EncodedColumn& encoded_column, const std::vector<int>& ids, Emit& emit) {
+    if (encoded_column.hasPostings()) {
+        encoded_column.postings.lookup(ids, emit);
+        return;
+    }
+    withIdSetMatcher(ids, encoded_column.dictionary.size(), [&](const auto& matcher) {
+        scanIds(encoded_column, matcher, emit);
+    });
+}
+
+// Rows whose ID is any of `ids`; see findIdRows
+std::vector<int> idSetScan(const EncodedColumn& encoded_column, const std::vector<int>& ids) {
+    SelectionCollector selection;
+    findIdRows(encoded_column, ids, selection);
+    return std::move(selection.indices);
+}
+
+// idSetScan as a bitmap with one bit per row
+std::vector<uint64_t> idSetScanBitmap(const EncodedColumn& encoded_column, const std::vector<int>& ids) {
+    BitmapCollector bitmap(encoded_column.size());
+    findIdRows(encoded_column, ids, bitmap);
+    return std::move(bitmap.words);
+}
+
+// idSetScan as a compressed RowSet
+RowSet idSetScanRows(const EncodedColumn& encoded_column, const std::vector<int>& ids) {
+    RowSetCollector rows(encoded_column.size());
+    findIdRows(encoded_column, ids, rows);
+    return rows.finish();
+}
 
-    // Merge local dictionaries into the global dictionary
-    std::mutex global_mutex;
-    std::vector<std::unordered_map<int, int>> local_to_global_maps(num_threads);
-    for (int t = 0; t < num_threads; ++t) {
-        mergeDictionaries(local_dicts[t], local_id_to_data[t], encoded_column.dictionary, local_to_global_maps[t], global_mutex);
-    }
+// Rows equal to `value`, as a compressed RowSet
+RowSet queryRows(const EncodedColumn& encoded_column, const std::string& value) {
+    int id = encoded_column.dictionary.find(value);
+    return id < 0 ? RowSet(encoded_column.size()) : idSetScanRows(encoded_column, {id});
+}
 
-    // Remap encoded data with global IDs
-    for (int t = 0; t < num_threads; ++t) {
-        size_t start = t * chunk_size;
-        for (size_t i = 0; i < local_encoded_chunks[t].size(); ++i) {
-            encoded_column.encoded_data[start + i] = local_to_global_maps[t][local_encoded_chunks[t][i]];
-        }
+// Rows whose value v satisfies lower <= v < upper. Needs a sorted dictionary.
+std::vector<int> lexicalRangeQuery(const EncodedColumn& encoded_column, const std::string& lower, const std::string& upper) {
+    if (!encoded_column.dictionary.isSorted()) {
+        std::cerr << "Error: Range queries need a sorted dictionary.\n";
+        return {};
     }
-
-    return encoded_column;
+    const Dictionary& dictionary = encoded_column.dictionary;
+    return idRangeScan(encoded_column, dictionary.lowerBound(lower), dictionary.lowerBound(upper));
 }
 
 
-// SIMD prefix query search
-std::vector<std::pair<std::string, std::vector<int>>> simdPrefixQuery(const EncodedColumn& encoded_column, const std::string& prefix) {
-    std::vector<std::pair<std::string, std::vector<int>>> results;
+// IDs of the dictionary entries starting with `prefix`, ascending. A sorted dictionary finds them by binary
+// search. Otherwise a SIMD filter compares the prefix's first bytes against every entry's head (its first
+// Dictionary::HEAD_BYTES bytes), 8 entries per step with AVX-512, and only the candidates are checked in full
+// against the length and the rest of the prefix in the arena.
+std::vector<int> prefixMatchingIds(const Dictionary& dictionary, const std::string& prefix) {
+    std::vector<int> ids;
 
     size_t prefix_length = prefix.size();
     if (prefix_length == 0) {
         std::cerr << "Error: Prefix length cannot be zero.\n";
-        return results;
+        return ids;
     }
 
-    const auto& dict_entries = encoded_column.dictionary.id_to_data;
+    if (dictionary.isSorted()) {
+        std::pair<int, int> range = dictionary.prefixRange(prefix);
+        for (int id = range.first; id < range.second; ++id) {
+            ids.push_back(id);
+        }
+        return ids;
+    }
 
-    // Precompute prefix mask for the first `prefix_length` bytes
-    int prefix_mask = (1 << prefix_length) - 1;
+    // The head bytes a matching entry must have, and which of them the prefix covers
+    size_t head_length = std::min(prefix_length, Dictionary::HEAD_BYTES);
+    uint64_t prefix_head = 0;
+    std::memcpy(&prefix_head, prefix.data(), head_length);
+    uint64_t head_mask = head_length == Dictionary::HEAD_BYTES ? ~uint64_t(0) : (uint64_t(1) << (8 * head_length)) - 1;
+
+    const uint64_t* heads = dictionary.headData();
+    const uint32_t* lengths = dictionary.lengthData();
+    std::string_view rest = std::string_view(prefix).substr(head_length);
+    auto verify = [&](size_t id) {
+        if (lengths[id] >= prefix_length &&
+            (rest.empty() || dictionary.value(id).substr(head_length, rest.size()) == rest)) {
+            ids.push_back(static_cast<int>(id));
+        }
+    };
+
+    size_t count = dictionary.size();
+    size_t id = 0;
+#if defined(__AVX512F__)
+    __m512i prefix_vec = _mm512_set1_epi64(prefix_head);
+    __m512i mask_vec = _mm512_set1_epi64(head_mask);
+    for (; id + 8 <= count; id += 8) {
+        __m512i head_vec = _mm512_and_si512(_mm512_loadu_si512(heads + id), mask_vec);
+        uint32_t candidates = _mm512_cmpeq_epi64_mask(head_vec, prefix_vec);
+        while (candidates) {
+            verify(id + __builtin_ctz(candidates));
+            candidates &= candidates - 1;
+        }
+    }
+#else
+    __m256i prefix_vec = _mm256_set1_epi64x(prefix_head);
+    __m256i mask_vec = _mm256_set1_epi64x(head_mask);
+    for (; id + 4 <= count; id += 4) {
+        __m256i head_vec = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(heads + id)), mask_vec);
+        uint32_t candidates = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(head_vec, prefix_vec)));
+        while (candidates) {
+            verify(id + __builtin_ctz(candidates));
+            candidates &= candidates - 1;
+        }
+    }
+#endif
+    for (; id < count; ++id) {
+        if ((heads[id] & head_mask) == prefix_head) {
+            verify(id);
+        }
+    }
 
-    // Load the prefix into a 256-bit SIMD register
-    __m256i prefix_vec = _mm256_setzero_si256();
-    std::memcpy(&prefix_vec, prefix.c_str(), std::min(prefix_length, size_t(32)));
+    return ids;
+}
 
-    // Process dictionary in chunks of 8 entries for SIMD acceleration
-    size_t i = 0;
-    for (; i + 8 <= dict_entries.size(); i += 8) {
-        alignas(32) char dict_buffer[8][32] = {0}; // Buffer to hold 8 dictionary entries
-
-        // Prepare dictionary entries for SIMD comparison
-        for (int j = 0; j < 8; ++j) {
-            const auto& dict_entry = dict_entries[i + j];
-            std::memcpy(dict_buffer[j], dict_entry.c_str(), std::min(dict_entry.size(), size_t(32)));
-        }
-
-        // Compare each dictionary entry with the prefix
-        for (int j = 0; j < 8; ++j) {
-            __m256i dict_vec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dict_buffer[j]));
-            __m256i cmp = _mm256_cmpeq_epi8(prefix_vec, dict_vec);
-            int mask = _mm256_movemask_epi8(cmp);
-
-            // Check if the first `prefix_length` bytes match
-            if ((mask & prefix_mask) == prefix_mask) {
-                const std::string& dict_entry = dict_entries[i + j];
-                std::vector<int> indices;
-
-                // Efficiently find indices in encoded data where this dictionary entry appears
-                for (size_t k = 0; k < encoded_column.encoded_data.size(); ++k) {
-                    if (encoded_column.encoded_data[k] == static_cast<int>(i + j)) {
-                        indices.push_back(k);
-                    }
-                }
+// Rows whose value starts with `prefix`, as a selection vector. The matching IDs are looked up in the posting
+// lists if the column has them. Otherwise they become one matcher (a range on a sorted dictionary, else an ID
+// bitmap), so the column is scanned once however many entries match.
+std::vector<int> prefixQuery(const EncodedColumn& encoded_column, const std::string& prefix) {
+    return idSetScan(encoded_column, prefixMatchingIds(encoded_column.dictionary, prefix));
+}
 
-                results.emplace_back(dict_entry, indices);
-            }
-        }
-    }
+// prefixQuery as a bitmap with one bit per row
+std::vector<uint64_t> prefixQueryBitmap(const EncodedColumn& encoded_column, const std::string& prefix) {
+    return idSetScanBitmap(encoded_column, prefixMatchingIds(encoded_column.dictionary, prefix));
+}
 
-    // Handle remaining dictionary entries that do not fit into chunks of 8
-    for (; i < dict_entries.size(); ++i) {
-        const auto& dict_entry = dict_entries[i];
-        if (dict_entry.size() >= prefix_length && dict_entry.compare(0, prefix_length, prefix) == 0) {
-            std::vector<int> indices;
+// prefixQuery as a compressed RowSet
+RowSet prefixQueryRows(const EncodedColumn& encoded_column, const std::string& prefix) {
+    return idSetScanRows(encoded_column, prefixMatchingIds(encoded_column.dictionary, prefix));
+}
 
-            for (size_t k = 0; k < encoded_column.encoded_data.size(); ++k) {
-                if (encoded_column.encoded_data[k] == static_cast<int>(i)) {
-                    indices.push_back(k);
-                }
-            }
+// SIMD prefix query search, grouped by matching dictionary entry. One column pass finds every matching row,
+// which is then filed under its entry; with posting lists each entry's list is its group.
+std::vector<std::pair<std::string, std::vector<int>>> simdPrefixQuery(const EncodedColumn& encoded_column, const std::string& prefix) {
+    std::vector<std::pair<std::string, std::vector<int>>> results;
 
-            results.emplace_back(dict_entry, indices);
+    const Dictionary& dictionary = encoded_column.dictionary;
+    std::vector<int> ids = prefixMatchingIds(dictionary, prefix);
+    if (ids.empty()) {
+        return results;
+    }
+
+    if (encoded_column.hasPostings()) {
+        for (int id : ids) {
+            SelectionCollector selection;
+            encoded_column.postings.lookup({id}, selection);
+            results.emplace_back(std::string(dictionary.value(id)), std::move(selection.indices));
         }
+        return results;
     }
 
+    std::vector<std::vector<int>> rows_per_id(ids.size());
+    for (int row : idSetScan(encoded_column, ids)) {
+        int id = encoded_column.id(row);
+        rows_per_id[std::lower_bound(ids.begin(), ids.end(), id) - ids.begin()].push_back(row);
+    }
+    for (size_t i = 0; i < ids.size(); ++i) {
+        results.emplace_back(std::string(dictionary.value(ids[i])), std::move(rows_per_id[i]));
+    }
     return results;
 }
 
@@ -231,41 +2283,65 @@ std::vector<std::string> vanillaPrefixQuery(const std::vector<std::string>& data
     return results;
 }
 
+// Rows starting with `prefix`, with no simd: the reference the row-returning prefix queries are checked against
+std::vector<int> vanillaPrefixRows(const std::vector<std::string>& data, const std::string& prefix) {
+    std::vector<int> rows;
+    for (size_t i = 0; i < data.size(); ++i) {
+        if (data[i].compare(0, prefix.size(), prefix) == 0) {
+            rows.push_back(i);
+        }
+    }
+    return rows;
+}
+
 
 // SIMD for singular item
 std::vector<int> simdQuery(const EncodedColumn& encoded_column, const std::string& query) {
     std::vector<int> indices;
 
     // check if the query exists in the dictionary
-    auto it = encoded_column.dictionary.data_to_id.find(query);
-    if (it == encoded_column.dictionary.data_to_id.end()) {
+    int query_id = encoded_column.dictionary.find(query);
+    if (query_id < 0) {
         return indices; 
     }
+    if (encoded_column.hasPostings()) {
+        return idSetScan(encoded_column, {query_id});   // O(matches) from the posting list
+    }
+    if (encoded_column.encoded_data.empty()) {
+        return packedQuery(encoded_column, query);   // opened from a binary file: only the packed IDs exist
+    }
+    if (encoded_column.hasNarrowData()) {
+        return idRangeScan(encoded_column, query_id, query_id + 1);   // 2-4x as many IDs per compare
+    }
 
-    int query_id = it->second;
-
-    // SIMD search for matching IDs in the encoded data
+    // SIMD search for matching IDs in the encoded data, zone by zone, skipping the zones that cannot hold query_id
     size_t data_size = encoded_column.encoded_data.size();
     size_t simd_width = 8; 
     __m256i query_vec = _mm256_set1_epi32(query_id);
 
-    size_t i = 0;
-    for (; i + simd_width <= data_size; i += simd_width) {
-        __m256i data_vec = _mm256_loadu_si256((__m256i*)&encoded_column.encoded_data[i]);
-        __m256i cmp = _mm256_cmpeq_epi32(data_vec, query_vec);
-        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(cmp));
+    for (size_t zone_start = 0; zone_start < data_size; zone_start += EncodedColumn::ZONE_ROWS) {
+        size_t zone = zone_start / EncodedColumn::ZONE_ROWS;
+        if (zone < encoded_column.zones.size() && !encoded_column.zones[zone].mayContain(query_id)) {
+            continue;
+        }
+        size_t zone_end = std::min(zone_start + EncodedColumn::ZONE_ROWS, data_size);
 
-        for (int j = 0; j < simd_width; ++j) {
-            if (mask & (1 << j)) {
-                indices.push_back(i + j);
+        size_t i = zone_start;
+        for (; i + simd_width <= zone_end; i += simd_width) {
+            __m256i data_vec = _mm256_loadu_si256((__m256i*)&encoded_column.encoded_data[i]);
+            __m256i cmp = _mm256_cmpeq_epi32(data_vec, query_vec);
+            int mask = _mm256_movemask_ps(_mm256_castsi256_ps(cmp));
+
+            for (; mask; mask &= mask - 1) {
+                indices.push_back(i + __builtin_ctz(mask));
             }
         }
-    }
 
-    // scalar processing for remaining elements
-    for (; i < data_size; ++i) {
-        if (encoded_column.encoded_data[i] == query_id) {
-            indices.push_back(i);
+        // scalar processing for remaining elements
+        for (; i < zone_end; ++i) {
+            if (encoded_column.encoded_data[i] == query_id) {
+                indices.push_back(i);
+            }
         }
     }
 
@@ -273,6 +2349,216 @@ std::vector<int> simdQuery(const EncodedColumn& encoded_column, const std::strin
 }
 
 
+// Runs queries over a column on a fixed pool of threads. Each pass over the column is split into morsels of
+// MORSEL_BLOCKS blocks that the threads claim from a shared counter, so a thread that falls behind just claims
+// fewer. A batch of queries is answered in one pass: each block is read from memory once and then tested
+// against every query's matcher while it is still in cache. A bit-packed block is unpacked once for the whole
+// batch rather than once per query. A morsel lies inside one zone, and only the queries the zone map allows for
+// that zone scan it.
+class QueryEngine {
+public:
+    static constexpr size_t MORSEL_BLOCKS = 64;   // 32768 rows
+    static_assert(EncodedColumn::ZONE_ROWS % (MORSEL_BLOCKS * PackedColumn::BLOCK_ROWS) == 0,
+                  "a morsel must not straddle zones");
+
+    enum QueryKind { EQUALS, PREFIX };
+    struct Query {
+        QueryKind kind;
+        std::string value;
+    };
+
+    // Throughput of the last run
+    struct Stats {
+        size_t queries = 0;
+        size_t bytes_scanned = 0;   // ID bytes read from the column, once per pass, not counting skipped zones
+        double seconds = 0;
+
+        double queriesPerSecond() const { return seconds > 0 ? queries / seconds : 0; }
+        double gigabytesPerSecond() const { return seconds > 0 ? bytes_scanned / seconds / 1e9 : 0; }
+    };
+
+    // The pool has num_threads - 1 workers; the calling thread scans too
+    QueryEngine(const EncodedColumn& encoded_column, int num_threads) : column(encoded_column) {
+        for (int t = 1; t < num_threads; ++t) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~QueryEngine() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    QueryEngine(const QueryEngine&) = delete;
+    QueryEngine& operator=(const QueryEngine&) = delete;
+
+    int numThreads() const { return static_cast<int>(workers.size()) + 1; }
+    const Stats& lastStats() const { return stats; }
+
+    std::vector<int> query(const std::string& value) { return std::move(run({{EQUALS, value}})[0]); }
+    std::vector<int> prefixQuery(const std::string& prefix) { return std::move(run({{PREFIX, prefix}})[0]); }
+
+    // The matching rows of each of `queries`, ascending, from a single shared pass over the column
+    std::vector<std::vector<int>> run(const std::vector<Query>& queries) {
+        auto start = std::chrono::high_resolution_clock::now();
+        const Dictionary& dictionary = column.dictionary;
+
+        std::vector<IdSetFilter> filters;
+        std::vector<size_t> active;   // queries with at least one matching ID
+        filters.reserve(queries.size());
+        for (const Query& query : queries) {
+            std::vector<int> ids;
+            if (query.kind == PREFIX) {
+                ids = prefixMatchingIds(dictionary, query.value);
+            } else if (int id = dictionary.find(query.value); id >= 0) {
+                ids.push_back(id);
+            }
+            filters.emplace_back(std::move(ids), dictionary.size());
+            if (!filters.back().empty()) {
+                active.push_back(filters.size() - 1);
+            }
+        }
+
+        // One selection per (morsel, active query), concatenated in morsel order afterwards
+        size_t num_blocks = (column.size() + PackedColumn::BLOCK_ROWS - 1) / PackedColumn::BLOCK_ROWS;
+        size_t num_morsels = (num_blocks + MORSEL_BLOCKS - 1) / MORSEL_BLOCKS;
+        std::vector<SelectionCollector> selections(active.empty() ? 0 : num_morsels * active.size());
+        std::atomic<size_t> blocks_scanned(0);
+        if (!active.empty()) {
+            parallelFor(num_morsels, [&](size_t morsel) {
+                size_t first_block = morsel * MORSEL_BLOCKS;
+                size_t last_block = std::min(first_block + MORSEL_BLOCKS, num_blocks);
+                SelectionCollector* out = &selections[morsel * active.size()];
+
+                // The active queries the morsel's zone may match, as indices into `active`
+                size_t zone = first_block * PackedColumn::BLOCK_ROWS / EncodedColumn::ZONE_ROWS;
+                std::vector<size_t> live;
+                for (size_t a = 0; a < active.size(); ++a) {
+                    if (zone >= column.zones.size() || filters[active[a]].mayMatch(column.zones[zone])) {
+                        live.push_back(a);
+                    }
+                }
+                if (live.empty()) {
+                    return;
+                }
+                blocks_scanned += last_block - first_block;
+
+                bool unpack_once = live.size() > 1 && !column.hasNarrowData() && column.hasPackedData();
+                alignas(64) int ids[PackedColumn::BLOCK_ROWS];
+                for (size_t block = first_block; block < last_block; ++block) {
+                    if (!unpack_once) {
+                        for (size_t a : live) {
+                            filters[active[a]].visit([&](const auto& matcher) {
+                                scanIdBlocks(column, matcher, out[a], block, block + 1);
+                            });
+                        }
+                        continue;
+                    }
+
+                    unpackBlock(column.packed_data, block, ids);
+                    size_t block_start = block * PackedColumn::BLOCK_ROWS;
+                    size_t block_rows = std::min(PackedColumn::BLOCK_ROWS, column.size() - block_start);
+                    for (size_t a : live) {
+                        auto emit = [&](uint32_t mask, size_t row) { out[a](mask, block_start + row); };
+                        filters[active[a]].visit([&](const auto& matcher) {
+                            scanUnpacked(ids, block_rows, matcher, emit);
+                        });
+                    }
+                }
+            });
+        }
+
+        std::vector<std::vector<int>> results(queries.size());
+        for (size_t a = 0; a < active.size(); ++a) {
+            std::vector<int>& rows = results[active[a]];
+            size_t total = 0;
+            for (size_t morsel = 0; morsel < num_morsels; ++morsel) {
+                total += selections[morsel * active.size() + a].indices.size();
+            }
+            rows.reserve(total);
+            for (size_t morsel = 0; morsel < num_morsels; ++morsel) {
+                const std::vector<int>& part = selections[morsel * active.size() + a].indices;
+                rows.insert(rows.end(), part.begin(), part.end());
+            }
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        stats.queries = queries.size();
+        size_t block_bytes = column.hasNarrowData() ? PackedColumn::BLOCK_ROWS * column.narrow_width
+                             : column.hasPackedData() ? column.packed_data.bitWidth() * PackedColumn::LANES * sizeof(uint32_t)
+                                                      : PackedColumn::BLOCK_ROWS * sizeof(int);
+        stats.bytes_scanned = blocks_scanned.load() * block_bytes;
+        stats.seconds = elapsed.count();
+        return results;
+    }
+
+private:
+    // Run job(i) for every i in [0, count) across the pool and the calling thread; returns when all are done
+    void parallelFor(size_t count, const std::function<void(size_t)>& job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current_job = &job;
+            job_count = count;
+            next_index.store(0);
+            busy_workers = workers.size();
+            ++generation;
+        }
+        wake.notify_all();
+        claimJobs(job, count);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return busy_workers == 0; });
+        current_job = nullptr;
+    }
+
+    void claimJobs(const std::function<void(size_t)>& job, size_t count) {
+        for (size_t i = next_index.fetch_add(1); i < count; i = next_index.fetch_add(1)) {
+            job(i);
+        }
+    }
+
+    void workerLoop() {
+        uint64_t seen_generation = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] { return stopping || generation != seen_generation; });
+            if (stopping) {
+                return;
+            }
+            seen_generation = generation;
+            const std::function<void(size_t)>& job = *current_job;
+            size_t count = job_count;
+            lock.unlock();
+            claimJobs(job, count);
+            lock.lock();
+            if (--busy_workers == 0) {
+                done.notify_one();
+            }
+        }
+    }
+
+    const EncodedColumn& column;
+    Stats stats;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(size_t)>* current_job = nullptr;
+    size_t job_count = 0;
+    std::atomic<size_t> next_index{0};
+    size_t busy_workers = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+};
+
+
 // vanilla search for singular item
 std::vector<int> vanillaSearch(const std::vector<std::string>& raw_data, const std::string& query) {
     std::vector<int> result_indices;
@@ -307,14 +2593,14 @@ void writeEncodedColumnToFile(const EncodedColumn& encoded_column, const std::st
 
     // Write the dictionary to the file
     file << "Dictionary:\n";
-    for (size_t i = 0; i < encoded_column.dictionary.id_to_data.size(); ++i) {
-        file << i << ": " << encoded_column.dictionary.id_to_data[i] << "\n";
+    for (size_t i = 0; i < encoded_column.dictionary.size(); ++i) {
+        file << i << ": " << encoded_column.dictionary.value(i) << "\n";
     }
 
     // Write the encoded data
     file << "\nEncoded Data:\n";
-    for (int id : encoded_column.encoded_data) {
-        file << id << " ";
+    for (size_t row = 0; row < encoded_column.size(); ++row) {
+        file << encoded_column.id(row) << " ";
     }
     file << "\n";
 
@@ -322,27 +2608,643 @@ void writeEncodedColumnToFile(const EncodedColumn& encoded_column, const std::st
 }
 
 
+
+// Binary column files. The layout is a fixed header followed by eight sections, each starting on a 64-byte
+// boundary and protected by its own CRC32C: the dictionary offsets, lengths, string arena and hash index
+// (Dictionary's own arrays, the index as a tag/ID word and a location per slot, hashed with Dictionary's fixed
+// hash so any build reads it), the bit-packed IDs (PackedColumn's words), then the posting list offsets, counts
+// and bytes (PostingIndex's arrays; empty unless the column had posting lists). Integers are little-endian.
+// Opening maps the file: the dictionary arrays and posting offsets are bulk-copied (the stored index means
+// nothing is rehashed) and the packed IDs and posting lists are used straight from the mapping, so queries start
+// without a parse step.
+constexpr char COLUMN_FILE_MAGIC[8] = {'D', 'I', 'C', 'T', 'C', 'O', 'L', '\0'};
+constexpr uint32_t COLUMN_FILE_VERSION = 3;   // 3: the index uses Dictionary's fixed hash
+constexpr uint32_t COLUMN_FILE_SORTED = 1;     // header flag: the dictionary is order-preserving
+constexpr uint32_t COLUMN_FILE_POSTINGS = 2;   // header flag: the posting list sections are filled
+constexpr size_t COLUMN_FILE_ALIGNMENT = 64;
+
+enum ColumnFileSectionId {
+    SECTION_OFFSETS, SECTION_LENGTHS, SECTION_ARENA, SECTION_INDEX, SECTION_IDS,
+    SECTION_POSTING_OFFSETS, SECTION_POSTING_COUNTS, SECTION_POSTINGS, NUM_SECTIONS
+};
+
+struct ColumnFileSection {
+    uint64_t offset;     // from the start of the file
+    uint64_t bytes;
+    uint64_t checksum;   // CRC32C of the section bytes
+};
+
+struct ColumnFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t num_rows;
+    uint64_t num_entries;
+    uint32_t bit_width;
+    uint32_t reserved;
+    ColumnFileSection sections[NUM_SECTIONS];
+    uint64_t header_checksum;   // CRC32C of every header byte before this field
+};
+
+// CRC32C with the SSE4.2 crc32 instruction, eight bytes per step
+uint64_t crc32c(const void* data, size_t bytes) {
+    const unsigned char* in = static_cast<const unsigned char*>(data);
+    uint64_t crc = 0xFFFFFFFFu;
+    size_t i = 0;
+    for (; i + 8 <= bytes; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, in + i, 8);
+        crc = _mm_crc32_u64(crc, word);
+    }
+    for (; i < bytes; ++i) {
+        crc = _mm_crc32_u8(static_cast<uint32_t>(crc), in[i]);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Write `encoded_column` as a binary column file, one sequential write per section. The column is bit-packed
+// first if packEncodedColumn has not run. Posting lists are written if the column has them.
+bool writeEncodedColumnBinary(const EncodedColumn& encoded_column, const std::string& filename) {
+    PackedColumn packed = encoded_column.packed_data;
+    if (!encoded_column.hasPackedData()) {
+        packed.reset(encoded_column.size(), encoded_column.dictionary.size());
+        packed.packBlocks(encoded_column.encoded_data.data(), 0, packed.numBlocks());
+    }
+
+    const Dictionary& dictionary = encoded_column.dictionary;
+    const PostingIndex& postings = encoded_column.postings;
+    bool has_postings = encoded_column.hasPostings();
+    std::vector<uint64_t> index = dictionary.indexWords();
+    const void* section_data[NUM_SECTIONS] = {dictionary.offsetData(), dictionary.lengthData(),
+                                              dictionary.arenaData(), index.data(), packed.wordData(),
+                                              postings.offsetData(), postings.countData(), postings.byteData()};
+    ColumnFileHeader header = {};
+    std::memcpy(header.magic, COLUMN_FILE_MAGIC, sizeof(header.magic));
+    header.version = COLUMN_FILE_VERSION;
+    header.flags = (dictionary.isSorted() ? COLUMN_FILE_SORTED : 0) | (has_postings ? COLUMN_FILE_POSTINGS : 0);
+    header.num_rows = packed.size();
+    header.num_entries = dictionary.size();
+    header.bit_width = packed.bitWidth();
+    header.sections[SECTION_OFFSETS].bytes = dictionary.size() * sizeof(uint64_t);
+    header.sections[SECTION_LENGTHS].bytes = dictionary.size() * sizeof(uint32_t);
+    header.sections[SECTION_ARENA].bytes = dictionary.arenaBytes();
+    header.sections[SECTION_INDEX].bytes = dictionary.indexBytes();
+    header.sections[SECTION_IDS].bytes = packed.memoryBytes();
+    if (has_postings) {
+        header.sections[SECTION_POSTING_OFFSETS].bytes = (dictionary.size() + 1) * sizeof(uint64_t);
+        header.sections[SECTION_POSTING_COUNTS].bytes = dictionary.size() * sizeof(uint32_t);
+        header.sections[SECTION_POSTINGS].bytes = postings.byteSize();
+    }
+
+    uint64_t position = sizeof(ColumnFileHeader);
+    for (int i = 0; i < NUM_SECTIONS; ++i) {
+        position = (position + COLUMN_FILE_ALIGNMENT - 1) / COLUMN_FILE_ALIGNMENT * COLUMN_FILE_ALIGNMENT;
+        header.sections[i].offset = position;
+        header.sections[i].checksum = crc32c(section_data[i], header.sections[i].bytes);
+        position += header.sections[i].bytes;
+    }
+    header.header_checksum = crc32c(&header, offsetof(ColumnFileHeader, header_checksum));
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: Unable to open file for writing: " << filename << "\n";
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    position = sizeof(header);
+    const char padding[COLUMN_FILE_ALIGNMENT] = {};
+    for (int i = 0; i < NUM_SECTIONS; ++i) {
+        file.write(padding, header.sections[i].offset - position);
+        file.write(static_cast<const char*>(section_data[i]), header.sections[i].bytes);
+        position = header.sections[i].offset + header.sections[i].bytes;
+    }
+    if (!file) {
+        std::cerr << "Error: Failed writing column file: " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Open a binary column file written by writeEncodedColumnBinary into `encoded_column`. The header, the
+// dictionary sections and the posting offsets are always checksummed; the packed IDs and the posting lists,
+// which may be gigabytes, only with verify_ids.
+bool openEncodedColumnFile(const std::string& filename, EncodedColumn& encoded_column, bool verify_ids = false) {
+    std::shared_ptr<MappedFile> mapping = mapFile(filename);
+    if (!mapping) {
+        std::cerr << "Error: Unable to map column file: " << filename << "\n";
+        return false;
+    }
+
+    ColumnFileHeader header;
+    if (mapping->bytes < sizeof(header)) {
+        std::cerr << "Error: Column file is truncated: " << filename << "\n";
+        return false;
+    }
+    std::memcpy(&header, mapping->data, sizeof(header));
+    if (std::memcmp(header.magic, COLUMN_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.header_checksum != crc32c(&header, offsetof(ColumnFileHeader, header_checksum))) {
+        std::cerr << "Error: Not a column file or corrupt header: " << filename << "\n";
+        return false;
+    }
+    if (header.version != COLUMN_FILE_VERSION) {
+        std::cerr << "Error: Unsupported column file version " << header.version << ": " << filename << "\n";
+        return false;
+    }
+
+    const ColumnFileSection* sections = header.sections;
+    int bit_width = static_cast<int>(header.bit_width);
+    bool has_postings = header.flags & COLUMN_FILE_POSTINGS;
+    bool sizes_valid = bit_width == PackedColumn::bitWidthFor(header.num_entries) &&
+                       sections[SECTION_OFFSETS].bytes == header.num_entries * sizeof(uint64_t) &&
+                       sections[SECTION_LENGTHS].bytes == header.num_entries * sizeof(uint32_t) &&
+                       sections[SECTION_IDS].bytes == PackedColumn::wordsFor(header.num_rows, bit_width) * sizeof(uint32_t) &&
+                       sections[SECTION_POSTING_OFFSETS].bytes == (has_postings ? (header.num_entries + 1) * sizeof(uint64_t) : 0) &&
+                       sections[SECTION_POSTING_COUNTS].bytes == (has_postings ? header.num_entries * sizeof(uint32_t) : 0);
+    for (int i = 0; i < NUM_SECTIONS && sizes_valid; ++i) {
+        sizes_valid = sections[i].offset % COLUMN_FILE_ALIGNMENT == 0 && sections[i].offset <= mapping->bytes &&
+                      sections[i].bytes <= mapping->bytes - sections[i].offset;
+    }
+    if (!sizes_valid) {
+        std::cerr << "Error: Column file sections do not match its header: " << filename << "\n";
+        return false;
+    }
+
+    for (int i = 0; i < NUM_SECTIONS; ++i) {
+        if (((i != SECTION_IDS && i != SECTION_POSTINGS) || verify_ids) &&
+            crc32c(mapping->data + sections[i].offset, sections[i].bytes) != sections[i].checksum) {
+            std::cerr << "Error: Checksum mismatch in section " << i << " of column file: " << filename << "\n";
+            return false;
+        }
+    }
+
+    const char* base = mapping->data;
+    EncodedColumn column;
+    if (!column.dictionary.assignFromArrays(base + sections[SECTION_ARENA].offset, sections[SECTION_ARENA].bytes,
+                                            reinterpret_cast<const uint64_t*>(base + sections[SECTION_OFFSETS].offset),
+                                            reinterpret_cast<const uint32_t*>(base + sections[SECTION_LENGTHS].offset),
+                                            header.num_entries,
+                                            reinterpret_cast<const uint64_t*>(base + sections[SECTION_INDEX].offset),
+                                            sections[SECTION_INDEX].bytes, header.flags & COLUMN_FILE_SORTED)) {
+        std::cerr << "Error: Corrupt dictionary in column file: " << filename << "\n";
+        return false;
+    }
+
+    // The packed IDs stay in the mapping, which the column keeps alive
+    uint32_t* ids = reinterpret_cast<uint32_t*>(const_cast<char*>(base + sections[SECTION_IDS].offset));
+    column.packed_data.assignView(std::shared_ptr<uint32_t[]>(mapping, ids), header.num_rows, bit_width);
+
+    // So do the posting lists; their offsets and counts are copied
+    if (has_postings) {
+        const uint64_t* list_offsets = reinterpret_cast<const uint64_t*>(base + sections[SECTION_POSTING_OFFSETS].offset);
+        const uint32_t* list_counts = reinterpret_cast<const uint32_t*>(base + sections[SECTION_POSTING_COUNTS].offset);
+        uint8_t* lists = reinterpret_cast<uint8_t*>(const_cast<char*>(base + sections[SECTION_POSTINGS].offset));
+        if (!column.postings.assign(std::vector<uint64_t>(list_offsets, list_offsets + header.num_entries + 1),
+                                    std::vector<uint32_t>(list_counts, list_counts + header.num_entries),
+                                    std::shared_ptr<uint8_t[]>(mapping, lists), sections[SECTION_POSTINGS].bytes,
+                                    header.num_rows)) {
+            std::cerr << "Error: Corrupt posting lists in column file: " << filename << "\n";
+            return false;
+        }
+    }
+    encoded_column = std::move(column);
+    return true;
+}
+
+
+// Streaming encoder for columns that grow without bound. Rows arrive in batches and are encoded against one
+// global dictionary that keeps growing. Every segment_rows rows the active segment is sealed: it is bit-packed
+// at the width its own largest ID needs and appended to the segment file, with its row count, min/max ID and a
+// CRC32C. Queries map the segment file, skip sealed segments whose ID range cannot match, and then scan the
+// active segment. Memory stays bounded by the dictionary plus one segment, however long the stream runs, unless
+// writing fails: the rows then stay in the active segment and sealing is retried after the next segment_rows.
+class StreamingColumnEncoder {
+public:
+    struct SegmentInfo {
+        uint64_t offset;       // of the packed IDs in the segment file
+        uint64_t bytes;
+        uint64_t first_row;
+        uint64_t rows;
+        int bit_width;
+        uint32_t min_id;
+        uint32_t max_id;
+        uint64_t checksum;     // CRC32C of the packed IDs
+    };
+
+    StreamingColumnEncoder(const std::string& segment_path, size_t rows_per_segment = size_t(1) << 20)
+        : path(segment_path), segment_rows(std::max<size_t>(rows_per_segment, 1)),
+          file(segment_path, std::ios::binary | std::ios::trunc) {
+        if (!file) {
+            std::cerr << "Error: Unable to open segment file for writing: " << segment_path << "\n";
+        }
+        active.reserve(segment_rows);
+    }
+
+    const Dictionary& dictionary() const { return dict; }
+    const std::vector<SegmentInfo>& segments() const { return sealed; }
+    uint64_t size() const { return sealed_rows + active.size(); }
+
+    void append(std::string_view value) {
+        active.push_back(dict.insert(value));
+        if (active.size() % segment_rows == 0) {
+            seal();
+        }
+    }
+
+    template <typename Rows>
+    void appendBatch(const Rows& rows) {
+        for (const auto& row : rows) {
+            append(row);
+        }
+    }
+
+    // Pack the active segment and append it to the segment file (no-op when it is empty). Returns false if the
+    // write failed; the file is rewound past the partial segment and the rows stay in the active segment.
+    bool seal() {
+        if (active.empty()) {
+            return true;
+        }
+        SegmentHeader header = {};
+        std::memcpy(header.magic, SEGMENT_MAGIC, sizeof(header.magic));
+        header.rows = active.size();
+        header.min_id = *std::min_element(active.begin(), active.end());
+        header.max_id = *std::max_element(active.begin(), active.end());
+
+        PackedColumn packed;
+        packed.reset(active.size(), size_t(header.max_id) + 1);
+        packed.packBlocks(active.data(), 0, packed.numBlocks());
+        header.bit_width = packed.bitWidth();
+        header.bytes = packed.memoryBytes();
+        header.checksum = crc32c(packed.wordData(), header.bytes);
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(packed.wordData()), header.bytes);
+        file.flush();
+        if (!file) {
+            std::cerr << "Error: Failed writing segment to: " << path << "\n";
+            file.clear();
+            file.seekp(file_bytes);
+            return false;
+        }
+
+        sealed.push_back({file_bytes + sizeof(header), header.bytes, sealed_rows, header.rows, packed.bitWidth(),
+                          header.min_id, header.max_id, header.checksum});
+        file_bytes += sizeof(header) + header.bytes;
+        sealed_rows += header.rows;
+        active.clear();
+        return true;
+    }
+
+    // Rows equal to `value` across every segment
+    std::vector<uint64_t> query(const std::string& value, bool verify_segments = false) const {
+        int id = dict.find(value);
+        return id < 0 ? std::vector<uint64_t>() : idSetQuery({id}, verify_segments);
+    }
+
+    // Rows starting with `prefix` across every segment
+    std::vector<uint64_t> prefixQuery(const std::string& prefix, bool verify_segments = false) const {
+        return idSetQuery(prefixMatchingIds(dict, prefix), verify_segments);
+    }
+
+    // Rows whose ID is any of `ids`: one pass over each sealed segment whose min/max range overlaps the IDs,
+    // straight from the mapped segment file, then the active segment. A segment that lies outside the mapped
+    // file, or with verify_segments fails its CRC32C, is reported and skipped.
+    std::vector<uint64_t> idSetQuery(const std::vector<int>& ids, bool verify_segments = false) const {
+        std::vector<uint64_t> rows;
+        if (ids.empty()) {
+            return rows;
+        }
+        uint32_t lowest = *std::min_element(ids.begin(), ids.end());
+        uint32_t highest = *std::max_element(ids.begin(), ids.end());
+        std::shared_ptr<MappedFile> mapping = sealed.empty() ? nullptr : mapFile(path);
+        if (!sealed.empty() && !mapping) {
+            std::cerr << "Error: Unable to map segment file: " << path << "\n";
+        }
+
+        withIdSetMatcher(ids, dict.size(), [&](const auto& matcher) {
+            uint64_t row_offset = 0;
+            auto emit = [&](uint32_t mask, size_t first_row) {
+                while (mask) {
+                    rows.push_back(row_offset + first_row + __builtin_ctz(mask));
+                    mask &= mask - 1;
+                }
+            };
+            for (const SegmentInfo& segment : sealed) {
+                if (!mapping || segment.max_id < lowest || segment.min_id > highest) {
+                    continue;
+                }
+                if (segment.offset > mapping->bytes || segment.bytes > mapping->bytes - segment.offset) {
+                    std::cerr << "Error: Segment at row " << segment.first_row << " lies outside segment file: "
+                              << path << "\n";
+                    continue;
+                }
+                if (verify_segments && crc32c(mapping->data + segment.offset, segment.bytes) != segment.checksum) {
+                    std::cerr << "Error: Checksum mismatch in segment at row " << segment.first_row
+                              << " of segment file: " << path << "\n";
+                    continue;
+                }
+                uint32_t* words = reinterpret_cast<uint32_t*>(const_cast<char*>(mapping->data + segment.offset));
+                PackedColumn packed;
+                packed.assignView(std::shared_ptr<uint32_t[]>(mapping, words), segment.rows, segment.bit_width);
+                row_offset = segment.first_row;
+                scanPacked(packed, matcher, emit);
+            }
+            row_offset = sealed_rows;
+            scanUnpacked(active.data(), active.size(), matcher, emit);
+        });
+        return rows;
+    }
+
+private:
+    static constexpr char SEGMENT_MAGIC[8] = {'D', 'I', 'C', 'T', 'S', 'E', 'G', '\0'};
+
+    // Precedes each segment's packed IDs in the file; 64 bytes, so the IDs stay 64-byte aligned
+    struct SegmentHeader {
+        char magic[8];
+        uint64_t rows;
+        uint64_t bytes;
+        uint64_t checksum;   // CRC32C of the packed IDs
+        uint32_t bit_width;
+        uint32_t min_id;
+        uint32_t max_id;
+        uint32_t reserved[5];
+    };
+    static_assert(sizeof(SegmentHeader) == 64, "segment headers keep the packed IDs 64-byte aligned");
+
+    std::string path;
+    size_t segment_rows;
+    std::ofstream file;
+    uint64_t file_bytes = 0;
+    Dictionary dict;
+    std::vector<int> active;
+    std::vector<SegmentInfo> sealed;
+    uint64_t sealed_rows = 0;
+};
+
+// Integer columns: IDs, timestamps, or fixed-width codes held in an integer. No string is hashed or stored.
+// Each value becomes a small unsigned code, bit-packed in a PackedColumn and scanned by the same kernels as the
+// string column's IDs.
+//  - DICTIONARY: the code is the value's index among the distinct values, ascending. The dictionary preserves
+//    order, so a value range is one code range.
+//  - FRAME_OF_REFERENCE: for columns too diverse for a dictionary to pay off, each packed block keeps its
+//    min/max and the code is the distance from the block minimum. A query skips the blocks its range misses.
+template <typename T>
+struct TypedColumn {
+    static_assert(std::is_integral<T>::value, "TypedColumn holds integer values");
+    using Unsigned = typename std::make_unsigned<T>::type;
+
+    enum Encoding { DICTIONARY, FRAME_OF_REFERENCE };
+
+    Encoding encoding = DICTIONARY;
+    std::vector<T> dictionary;   // DICTIONARY only
+    std::vector<T> block_min;    // FRAME_OF_REFERENCE only, one per packed block
+    std::vector<T> block_max;
+    PackedColumn codes;
+
+    size_t size() const { return codes.size(); }
+
+    size_t memoryBytes() const {
+        return codes.memoryBytes() + (dictionary.capacity() + block_min.capacity() + block_max.capacity()) * sizeof(T);
+    }
+
+    T value(size_t row) const {
+        uint32_t code = codes.get(row);
+        if (encoding == DICTIONARY) {
+            return dictionary[code];
+        }
+        return static_cast<T>(static_cast<Unsigned>(block_min[row / PackedColumn::BLOCK_ROWS]) + code);
+    }
+};
+
+// Encode an integer column on num_threads threads, each working on a contiguous run of blocks. The distinct
+// values are found by sorting: each thread sorts and dedups its rows and the runs are merged. Whichever of the
+// dictionary and frame of reference packs smaller is kept. Frame of reference needs every block's values to
+// span less than 2^32.
+template <typename T>
+TypedColumn<T> encodeTypedColumn(const std::vector<T>& data, int num_threads) {
+    using Unsigned = typename TypedColumn<T>::Unsigned;
+    constexpr size_t BLOCK_ROWS = PackedColumn::BLOCK_ROWS;
+    TypedColumn<T> column;
+    size_t rows = data.size();
+    size_t num_blocks = (rows + BLOCK_ROWS - 1) / BLOCK_ROWS;
+    num_threads = std::max(num_threads, 1);
+
+    auto forBlockRuns = [&](const auto& work) {
+        size_t blocks_per_thread = (num_blocks + num_threads - 1) / num_threads;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < num_threads; ++t) {
+            size_t first = t * blocks_per_thread;
+            size_t last = std::min(first + blocks_per_thread, num_blocks);
+            if (first < last) {
+                threads.emplace_back([&work, t, first, last] { work(t, first, last); });
+            }
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    };
+
+    // Distinct values per thread, and the min/max of every block
+    std::vector<std::vector<T>> local_values(num_threads);
+    column.block_min.resize(num_blocks);
+    column.block_max.resize(num_blocks);
+    forBlockRuns([&](int t, size_t first, size_t last) {
+        std::vector<T>& values = local_values[t];
+        values.assign(data.begin() + first * BLOCK_ROWS, data.begin() + std::min(last * BLOCK_ROWS, rows));
+        for (size_t block = first; block < last; ++block) {
+            auto block_begin = data.begin() + block * BLOCK_ROWS;
+            auto block_end = data.begin() + std::min((block + 1) * BLOCK_ROWS, rows);
+            auto min_max = std::minmax_element(block_begin, block_end);
+            column.block_min[block] = *min_max.first;
+            column.block_max[block] = *min_max.second;
+        }
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+    });
+
+    std::vector<T>& dictionary = column.dictionary;
+    for (std::vector<T>& values : local_values) {
+        std::vector<T> merged;
+        merged.reserve(dictionary.size() + values.size());
+        std::set_union(dictionary.begin(), dictionary.end(), values.begin(), values.end(), std::back_inserter(merged));
+        dictionary.swap(merged);
+        std::vector<T>().swap(values);
+    }
+
+    // Packed size of each encoding
+    uint64_t max_span = 0;
+    for (size_t block = 0; block < num_blocks; ++block) {
+        max_span = std::max<uint64_t>(max_span, static_cast<Unsigned>(static_cast<Unsigned>(column.block_max[block]) -
+                                                                      static_cast<Unsigned>(column.block_min[block])));
+    }
+    size_t dictionary_bytes = PackedColumn::wordsFor(rows, PackedColumn::bitWidthFor(dictionary.size())) *
+                                  sizeof(uint32_t) + dictionary.size() * sizeof(T);
+    bool reference_fits = max_span <= UINT32_MAX;
+    size_t reference_bytes = PackedColumn::wordsFor(rows, PackedColumn::bitWidthFor(max_span + 1)) *
+                                 sizeof(uint32_t) + 2 * num_blocks * sizeof(T);
+
+    std::vector<int> codes(rows);
+    if (reference_fits && reference_bytes < dictionary_bytes) {
+        column.encoding = TypedColumn<T>::FRAME_OF_REFERENCE;
+        std::vector<T>().swap(dictionary);
+        forBlockRuns([&](int, size_t first, size_t last) {
+            for (size_t row = first * BLOCK_ROWS; row < std::min(last * BLOCK_ROWS, rows); ++row) {
+                Unsigned base = static_cast<Unsigned>(column.block_min[row / BLOCK_ROWS]);
+                codes[row] = static_cast<int>(static_cast<uint32_t>(static_cast<Unsigned>(data[row]) - base));
+            }
+        });
+        column.codes.reset(rows, max_span + 1);
+    } else {
+        std::vector<T>().swap(column.block_min);
+        std::vector<T>().swap(column.block_max);
+        // Codes come from a linear-probing table from value to code, built once from the sorted values, which
+        // costs one or two cache misses per row instead of a binary search
+        int table_bits = 4;
+        while ((size_t(1) << table_bits) < 2 * dictionary.size()) {
+            ++table_bits;
+        }
+        size_t table_mask = (size_t(1) << table_bits) - 1;
+        std::vector<T> table_values(table_mask + 1);
+        std::vector<uint32_t> table_codes(table_mask + 1, UINT32_MAX);
+        auto slotOf = [&](T value) {
+            return static_cast<size_t>((uint64_t(static_cast<Unsigned>(value)) * 0x9E3779B97F4A7C15ull) >> (64 - table_bits));
+        };
+        for (size_t code = 0; code < dictionary.size(); ++code) {
+            size_t slot = slotOf(dictionary[code]);
+            while (table_codes[slot] != UINT32_MAX) {
+                slot = (slot + 1) & table_mask;
+            }
+            table_values[slot] = dictionary[code];
+            table_codes[slot] = static_cast<uint32_t>(code);
+        }
+        forBlockRuns([&](int, size_t first, size_t last) {
+            for (size_t row = first * BLOCK_ROWS; row < std::min(last * BLOCK_ROWS, rows); ++row) {
+                size_t slot = slotOf(data[row]);
+                while (table_values[slot] != data[row] || table_codes[slot] == UINT32_MAX) {
+                    slot = (slot + 1) & table_mask;
+                }
+                codes[row] = static_cast<int>(table_codes[slot]);
+            }
+        });
+        column.codes.reset(rows, dictionary.size());
+    }
+    forBlockRuns([&](int, size_t first, size_t last) { column.codes.packBlocks(codes.data(), first, last); });
+    return column;
+}
+
+// Rows whose value v satisfies lo <= v <= hi, ascending
+template <typename T>
+std::vector<int> typedRangeQuery(const TypedColumn<T>& column, T lo, T hi) {
+    using Unsigned = typename TypedColumn<T>::Unsigned;
+    SelectionCollector selection;
+    if (lo > hi) {
+        return {};
+    }
+
+    if (column.encoding == TypedColumn<T>::DICTIONARY) {
+        const std::vector<T>& dictionary = column.dictionary;
+        size_t first = std::lower_bound(dictionary.begin(), dictionary.end(), lo) - dictionary.begin();
+        size_t last = std::upper_bound(dictionary.begin(), dictionary.end(), hi) - dictionary.begin();
+        if (first < last) {
+            scanPacked(column.codes, IdRangeMatcher{static_cast<uint32_t>(first), static_cast<uint32_t>(last - first - 1)},
+                       selection);
+        }
+        return std::move(selection.indices);
+    }
+
+    for (size_t block = 0; block < column.codes.numBlocks(); ++block) {
+        T block_min = column.block_min[block];
+        T block_max = column.block_max[block];
+        if (hi < block_min || lo > block_max) {
+            continue;
+        }
+        uint32_t code_lo = lo <= block_min ? 0 : static_cast<uint32_t>(static_cast<Unsigned>(lo) - static_cast<Unsigned>(block_min));
+        uint32_t code_hi = static_cast<uint32_t>(static_cast<Unsigned>(std::min(hi, block_max)) - static_cast<Unsigned>(block_min));
+        scanPacked(column.codes, IdRangeMatcher{code_lo, code_hi - code_lo}, selection, block, block + 1);
+    }
+    return std::move(selection.indices);
+}
+
+// Rows equal to `value`
+template <typename T>
+std::vector<int> typedQuery(const TypedColumn<T>& column, T value) {
+    return typedRangeQuery(column, value, value);
+}
+
+// Load an integer column from a text file, one value per line
+template <typename T>
+std::vector<T> readTypedColumnFromFile(const std::string& filename) {
+    std::vector<T> data;
+    std::ifstream file(filename);
+    if (!file) {
+        std::cerr << "Error: Could not open file " << filename << "\n";
+        return data;
+    }
+    long long signed_value;
+    unsigned long long unsigned_value;
+    while (std::is_signed<T>::value ? bool(file >> signed_value) : bool(file >> unsigned_value)) {
+        data.push_back(std::is_signed<T>::value ? static_cast<T>(signed_value) : static_cast<T>(unsigned_value));
+    }
+    return data;
+}
+
+
 int main() {
     std::string input_file = "Column.txt";
     std::string output_file = "encoded_data.txt";
+    std::string binary_file = "encoded_column.bin";
+    std::string segments_file = "column_segments.bin";
     int num_threads ; 
     std::cout << "How many threads do you want for multithread encoding?" << std::endl;
     std::cin >> num_threads;
-    auto data = readColumnFromFile(input_file);
+    std::string sort_answer;
+    std::cout << "Sort the dictionary so prefix and range searches scan ID ranges? (y/n)" << std::endl;
+    std::cin >> sort_answer;
+    std::string postings_answer;
+    std::cout << "Build posting lists so singular and prefix searches look rows up instead of scanning? (y/n)" << std::endl;
+    std::cin >> postings_answer;
 
     auto start = std::chrono::high_resolution_clock::now();
-    auto encoded_column = encodeDictionary(data, num_threads);
+    auto encoded_column = encodeColumnFile(input_file, num_threads, sort_answer == "y", postings_answer == "y");
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed = end - start;
-    std::cout << "Encoding time: " << elapsed.count() << " s\n";
+    std::cout << "Ingest + encoding time: " << elapsed.count() << " s\n";
+
+    // The vanilla baselines search the raw strings
+    auto data = readColumnFromFile(input_file);
+    std::cout << "Dictionary: " << encoded_column.dictionary.size() << " entries in "
+              << encoded_column.dictionary.memoryBytes() << " bytes\n";
+    if (encoded_column.hasPostings()) {
+        std::cout << "Posting lists: " << encoded_column.postings.memoryBytes() << " bytes\n";
+    }
+
+    packEncodedColumn(encoded_column, num_threads);
+    std::cout << "Packed column: " << encoded_column.packed_data.bitWidth() << " bits per ID, "
+              << encoded_column.packed_data.memoryBytes() << " bytes (vs "
+              << encoded_column.encoded_data.size() * sizeof(int) << " unpacked)\n";
+    narrowEncodedColumn(encoded_column, num_threads);
+    std::cout << "Scan ID width: " << (encoded_column.hasNarrowData() ? encoded_column.narrow_width : 4) << " bytes\n";
 
     writeEncodedColumnToFile(encoded_column, output_file);
+    QueryEngine engine(encoded_column, num_threads);
+
+    // Round-trip through the binary column file; a later run could start from the mapping alone
+    if (writeEncodedColumnBinary(encoded_column, binary_file)) {
+        EncodedColumn mapped_column;
+        auto start_open = std::chrono::high_resolution_clock::now();
+        bool opened = openEncodedColumnFile(binary_file, mapped_column);
+        auto end_open = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed_open = end_open - start_open;
+        if (opened) {
+            std::cout << "Reopened " << binary_file << " (" << mapped_column.size() << " rows) in "
+                      << elapsed_open.count() << " s\n";
+        }
+    }
 
     std::string selection;
     
     bool quitting = false;
     while (quitting  == false){
-        std::cout << "Do you want singular search (s) or prefix search (p)? (Type x to cancel the program)" << std::endl;
+        std::cout << "Do you want singular search (s), prefix search (p), range search (r), a batch of searches (b), combined prefix searches (c), streaming ingest (a) or an integer column range search (i)? (Type x to cancel the program)" << std::endl;
         std::cin >> selection;
         if (selection == "x"){
             quitting = true;
@@ -371,7 +3273,26 @@ int main() {
             auto vanilla_single_results = vanillaSearch(data, query);
             auto end2 = std::chrono::high_resolution_clock::now();
             std::chrono::duration<double> elapsed2 = end2 - start2;
-            std::cout << "SIMD single search query time: " << elapsed1.count() << " s\n";
+
+            // Bit-packed Single Query Test
+            auto start5 = std::chrono::high_resolution_clock::now();
+            auto packed_single_results = packedQuery(encoded_column, query);
+            auto end5 = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed5 = end5 - start5;
+            if (packed_single_results != simd_single_results) {
+                std::cerr << "Error: bit-packed query disagrees with SIMD query\n";
+            }
+
+            // Multithreaded Single Query Test
+            auto parallel_single_results = engine.query(query);
+            if (parallel_single_results != simd_single_results) {
+                std::cerr << "Error: multithreaded query disagrees with SIMD query\n";
+            }
+            std::cout << (encoded_column.hasPostings() ? "Posting list" : "SIMD") << " single search query time: "
+                      << elapsed1.count() << " s\n";
+            std::cout << "Bit-packed single search query time: " << elapsed5.count() << " s\n";
+            std::cout << "Multithreaded (" << engine.numThreads() << " threads) single search query time: "
+                      << engine.lastStats().seconds << " s\n";
             std::cout << "Vanilla single search query time: " << elapsed2.count() << " s\n";
 
         }
@@ -403,10 +3324,188 @@ int main() {
             auto vanilla_prefix_results = vanillaPrefixQuery(data, prefix);
             auto end4 = std::chrono::high_resolution_clock::now();
             std::chrono::duration<double> elapsed4 = end4 - start4;
+
+            // Compressed row set Prefix Query Test
+            auto start7 = std::chrono::high_resolution_clock::now();
+            auto prefix_rows = prefixQueryRows(encoded_column, prefix);
+            auto end7 = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed7 = end7 - start7;
             std::cout << "SIMD Prefix query time: " << elapsed3.count() << " s\n";
+            std::cout << "Row set prefix query time: " << elapsed7.count() << " s (" << prefix_rows.size() << " rows in "
+                      << prefix_rows.memoryBytes() << " bytes)\n";
             std::cout << "Vanilla prefix query time: " << elapsed4.count() << " s\n";
 
         }
+        else if (selection == "r"){
+            std::string lower;
+            std::string upper;
+            std::cout << "Type the lower bound (inclusive) and upper bound (exclusive)" << std::endl;
+            std::cin >> lower >> upper;
+            auto start6 = std::chrono::high_resolution_clock::now();
+            auto range_results = lexicalRangeQuery(encoded_column, lower, upper);
+            auto end6 = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed6 = end6 - start6;
+            std::cout << "Range query matched " << range_results.size() << " rows in " << elapsed6.count() << " s\n";
+        }
+        else if (selection == "b"){
+            std::string line;
+            std::cout << "Type the queries on one line, separated by spaces (end a query with * to search for a prefix)" << std::endl;
+            std::getline(std::cin >> std::ws, line);
+            std::vector<QueryEngine::Query> queries;
+            size_t pos = 0;
+            while (pos < line.size()) {
+                size_t next = line.find(' ', pos);
+                std::string word = line.substr(pos, next == std::string::npos ? std::string::npos : next - pos);
+                pos = next == std::string::npos ? line.size() : next + 1;
+                if (word.empty()) {
+                    continue;
+                }
+                if (word.back() == '*') {
+                    queries.push_back({QueryEngine::PREFIX, word.substr(0, word.size() - 1)});
+                } else {
+                    queries.push_back({QueryEngine::EQUALS, word});
+                }
+            }
+
+            // The batch in one shared pass, then the same queries one pass each
+            auto batch_results = engine.run(queries);
+            QueryEngine::Stats batch_stats = engine.lastStats();
+            double one_at_a_time = 0;
+            for (const auto& query : queries) {
+                engine.run({query});
+                one_at_a_time += engine.lastStats().seconds;
+            }
+
+            for (size_t i = 0; i < queries.size(); ++i) {
+                std::cout << queries[i].value << (queries[i].kind == QueryEngine::PREFIX ? "*" : "") << ": "
+                          << batch_results[i].size() << " rows\n";
+            }
+            std::cout << "Batch of " << batch_stats.queries << " queries on " << engine.numThreads() << " threads: "
+                      << batch_stats.seconds << " s, " << batch_stats.queriesPerSecond() << " queries/s, "
+                      << batch_stats.gigabytesPerSecond() << " GB/s scanned\n";
+            std::cout << "Same queries one pass each: " << one_at_a_time << " s\n";
+        }
+        else if (selection == "c"){
+            std::string first_prefix;
+            std::string second_prefix;
+            std::cout << "Type two prefixes to combine as row sets" << std::endl;
+            std::cin >> first_prefix >> second_prefix;
+            RowSet first_rows = prefixQueryRows(encoded_column, first_prefix);
+            RowSet second_rows = prefixQueryRows(encoded_column, second_prefix);
+
+            auto start13 = std::chrono::high_resolution_clock::now();
+            RowSet both_rows = first_rows.intersectWith(second_rows);
+            RowSet either_rows = first_rows.unionWith(second_rows);
+            RowSet not_first_rows = first_rows.complement();
+            auto end13 = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed13 = end13 - start13;
+
+            // The same combinations on vanilla row lists
+            auto start14 = std::chrono::high_resolution_clock::now();
+            auto vanilla_first_rows = vanillaPrefixRows(data, first_prefix);
+            auto vanilla_second_rows = vanillaPrefixRows(data, second_prefix);
+            std::vector<int> vanilla_both_rows;
+            std::vector<int> vanilla_either_rows;
+            std::vector<int> vanilla_not_first_rows;
+            std::set_intersection(vanilla_first_rows.begin(), vanilla_first_rows.end(), vanilla_second_rows.begin(),
+                                  vanilla_second_rows.end(), std::back_inserter(vanilla_both_rows));
+            std::set_union(vanilla_first_rows.begin(), vanilla_first_rows.end(), vanilla_second_rows.begin(),
+                           vanilla_second_rows.end(), std::back_inserter(vanilla_either_rows));
+            for (size_t i = 0, next = 0; i < data.size(); ++i) {
+                if (next < vanilla_first_rows.size() && vanilla_first_rows[next] == int(i)) {
+                    ++next;
+                } else {
+                    vanilla_not_first_rows.push_back(i);
+                }
+            }
+            auto end14 = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed14 = end14 - start14;
+            if (both_rows.toVector() != vanilla_both_rows) {
+                std::cerr << "Error: row set AND disagrees with vanilla intersection\n";
+            }
+            if (either_rows.toVector() != vanilla_either_rows) {
+                std::cerr << "Error: row set OR disagrees with vanilla union\n";
+            }
+            if (not_first_rows.toVector() != vanilla_not_first_rows) {
+                std::cerr << "Error: row set NOT disagrees with vanilla complement\n";
+            }
+            std::cout << first_prefix << " AND " << second_prefix << ": " << both_rows.size() << " rows, OR: "
+                      << either_rows.size() << " rows, NOT " << first_prefix << ": " << not_first_rows.size() << " rows\n";
+            std::cout << "Row set AND/OR/NOT time: " << elapsed13.count() << " s\n";
+            std::cout << "Vanilla prefix search and set operations time: " << elapsed14.count() << " s\n";
+        }
+        else if (selection == "a"){
+            size_t rows_per_segment;
+            std::string query;
+            std::cout << "Type the rows per segment and a value to search for (its prefix search runs too)" << std::endl;
+            std::cin >> rows_per_segment >> query;
+
+            // Replay the column as a stream, sealing segments into segments_file as it grows
+            auto start8 = std::chrono::high_resolution_clock::now();
+            StreamingColumnEncoder stream(segments_file, rows_per_segment);
+            stream.appendBatch(data);
+            auto end8 = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed8 = end8 - start8;
+
+            auto start9 = std::chrono::high_resolution_clock::now();
+            auto stream_results = stream.query(query, true);
+            auto end9 = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed9 = end9 - start9;
+            auto stream_prefix_results = stream.prefixQuery(query, true);
+
+            auto vanilla_single_results = vanillaSearch(data, query);
+            auto vanilla_prefix_rows = vanillaPrefixRows(data, query);
+            if (!std::equal(stream_results.begin(), stream_results.end(), vanilla_single_results.begin(),
+                            vanilla_single_results.end())) {
+                std::cerr << "Error: streaming query disagrees with vanilla search\n";
+            }
+            if (!std::equal(stream_prefix_results.begin(), stream_prefix_results.end(), vanilla_prefix_rows.begin(),
+                            vanilla_prefix_rows.end())) {
+                std::cerr << "Error: streaming prefix query disagrees with vanilla prefix search\n";
+            }
+            std::cout << "Streamed " << stream.size() << " rows into " << stream.segments().size() << " segments in "
+                      << elapsed8.count() << " s\n";
+            std::cout << "Streaming query time (checksums verified): " << elapsed9.count() << " s ("
+                      << stream_results.size() << " rows, " << stream_prefix_results.size() << " with the prefix)\n";
+        }
+        else if (selection == "i"){
+            std::string integer_file;
+            int64_t lower;
+            int64_t upper;
+            std::cout << "Type an integer column file (one value per line), then the lower and upper bounds (inclusive)" << std::endl;
+            std::cin >> integer_file >> lower >> upper;
+            auto values = readTypedColumnFromFile<int64_t>(integer_file);
+
+            auto start10 = std::chrono::high_resolution_clock::now();
+            auto typed_column = encodeTypedColumn(values, num_threads);
+            auto end10 = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed10 = end10 - start10;
+
+            auto start11 = std::chrono::high_resolution_clock::now();
+            auto typed_results = typedRangeQuery(typed_column, lower, upper);
+            auto end11 = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed11 = end11 - start11;
+
+            // Vanilla range over the raw values
+            auto start12 = std::chrono::high_resolution_clock::now();
+            std::vector<int> vanilla_range_results;
+            for (size_t i = 0; i < values.size(); ++i) {
+                if (lower <= values[i] && values[i] <= upper) {
+                    vanilla_range_results.push_back(i);
+                }
+            }
+            auto end12 = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed12 = end12 - start12;
+            if (typed_results != vanilla_range_results) {
+                std::cerr << "Error: typed range query disagrees with vanilla range search\n";
+            }
+            std::cout << "Encoded " << values.size() << " integers with "
+                      << (typed_column.encoding == TypedColumn<int64_t>::DICTIONARY ? "a dictionary" : "frame of reference")
+                      << " at " << typed_column.codes.bitWidth() << " bits per row (" << typed_column.memoryBytes()
+                      << " bytes) in " << elapsed10.count() << " s\n";
+            std::cout << "Typed range query time: " << elapsed11.count() << " s (" << typed_results.size() << " rows)\n";
+            std::cout << "Vanilla range query time: " << elapsed12.count() << " s\n";
+        }
     }
 
 }